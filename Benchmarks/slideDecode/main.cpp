@@ -0,0 +1,135 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "slideprefetcher.h"
+
+#include <QGuiApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include <limits>
+
+
+#define N_REPEATS  3 // Each decode is repeated and the best time kept
+
+
+namespace {
+struct DecodeResult {
+    qint64 nsTime  = 0;
+    qint64 nBytes  = 0;
+    QSize  size;
+};
+
+
+// The old path: decode at full resolution and then downscale
+DecodeResult
+fullDecode(const QString& sFileName, QSize panelSize) {
+    DecodeResult result;
+    result.nsTime = std::numeric_limits<qint64>::max();
+    QElapsedTimer timer;
+    for(int i=0; i<N_REPEATS; i++) {
+        timer.start();
+        QImage image;
+        image.load(sFileName);
+        result.nBytes = image.sizeInBytes();
+        image = image.scaled(panelSize, Qt::KeepAspectRatio);
+        result.nsTime = qMin(result.nsTime, timer.nsecsElapsed());
+        result.size = image.size();
+    }
+    return result;
+}
+
+
+// The new path: the decoder is asked for the final size
+DecodeResult
+scaledDecode(const QString& sFileName, QSize panelSize) {
+    DecodeResult result;
+    result.nsTime = std::numeric_limits<qint64>::max();
+    QElapsedTimer timer;
+    for(int i=0; i<N_REPEATS; i++) {
+        timer.start();
+        QImage image = SlidePrefetcher::decodeSlide(sFileName, panelSize);
+        result.nBytes = image.sizeInBytes();
+        image = image.scaled(panelSize, Qt::KeepAspectRatio);
+        result.nsTime = qMin(result.nsTime, timer.nsecsElapsed());
+        result.size = image.size();
+    }
+    return result;
+}
+}
+
+
+int
+main(int argc, char *argv[]) {
+    QGuiApplication a(argc, argv);
+    QTextStream out(stdout);
+
+    QStringList args = a.arguments();
+    if(args.count() < 2) {
+        out << "Usage: " << args.at(0) << " <slide directory> [<width>x<height>]\n";
+        return 1;
+    }
+    QSize panelSize(1920, 1080);
+    if(args.count() > 2) {
+        QStringList sSize = args.at(2).split('x');
+        if(sSize.count() == 2)
+            panelSize = QSize(sSize.at(0).toInt(), sSize.at(1).toInt());
+    }
+    QDir slideDir(args.at(1));
+    slideDir.setNameFilters(QStringList() << "*.jpg" << "*.jpeg" << "*.png");
+    slideDir.setFilter(QDir::Files);
+    QFileInfoList slideList = slideDir.entryInfoList();
+    if(slideList.isEmpty()) {
+        out << "No slides found in " << args.at(1) << "\n";
+        return 1;
+    }
+
+    out << QString("Panel %1x%2, best of %3 runs\n")
+               .arg(panelSize.width()).arg(panelSize.height()).arg(N_REPEATS);
+    out << QString("%1 %2 %3 %4 %5\n")
+               .arg("Slide", -32)
+               .arg("full [ms]", 10)
+               .arg("scaled [ms]", 12)
+               .arg("full [MB]", 10)
+               .arg("scaled [MB]", 12);
+    qint64 nsFull = 0, nsScaled = 0;
+    qint64 peakFull = 0, peakScaled = 0;
+    for(const QFileInfo& slide : slideList) {
+        DecodeResult full   = fullDecode(slide.absoluteFilePath(), panelSize);
+        DecodeResult scaled = scaledDecode(slide.absoluteFilePath(), panelSize);
+        nsFull   += full.nsTime;
+        nsScaled += scaled.nsTime;
+        peakFull   = qMax(peakFull,   full.nBytes);
+        peakScaled = qMax(peakScaled, scaled.nBytes);
+        out << QString("%1 %2 %3 %4 %5\n")
+                   .arg(slide.fileName().left(32), -32)
+                   .arg(full.nsTime/1.0e6, 10, 'f', 1)
+                   .arg(scaled.nsTime/1.0e6, 12, 'f', 1)
+                   .arg(full.nBytes/1048576.0, 10, 'f', 1)
+                   .arg(scaled.nBytes/1048576.0, 12, 'f', 1);
+    }
+    out << QString("Total decode time: full %1 ms, scaled %2 ms (x%3)\n")
+               .arg(nsFull/1.0e6, 0, 'f', 1)
+               .arg(nsScaled/1.0e6, 0, 'f', 1)
+               .arg(double(nsFull)/qMax(nsScaled, qint64(1)), 0, 'f', 2);
+    out << QString("Largest decoded image: full %1 MB, scaled %2 MB\n")
+               .arg(peakFull/1048576.0, 0, 'f', 1)
+               .arg(peakScaled/1048576.0, 0, 'f', 1);
+    return 0;
+}
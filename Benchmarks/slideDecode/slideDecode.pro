@@ -0,0 +1,45 @@
+#Copyright (C) 2023  Gabriele Salvato
+
+#This program is free software: you can redistribute it and/or modify
+#it under the terms of the GNU General Public License as published by
+#the Free Software Foundation, either version 3 of the License, or
+#(at your option) any later version.
+
+#This program is distributed in the hope that it will be useful,
+#but WITHOUT ANY WARRANTY; without even the implied warranty of
+#MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#GNU General Public License for more details.
+
+#You should have received a copy of the GNU General Public License
+#along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+# Compares the full resolution decode of the slides (QImage::load
+# followed by a downscale) with the reduced resolution decode used
+# by SlidePrefetcher (QImageReader with the scaled size requested).
+#
+# Usage: slideDecode <slide directory> [<width>x<height>]
+
+
+QT += core
+QT += gui
+
+CONFIG += c++17
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+INCLUDEPATH += ../../CommonFiles
+
+SOURCES += \
+    ../../CommonFiles/slidecache.cpp \
+    ../../CommonFiles/slideprefetcher.cpp \
+    ../../CommonFiles/texturecompressor.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../CommonFiles/slidecache.h \
+    ../../CommonFiles/slideprefetcher.h \
+    ../../CommonFiles/texturecompressor.h
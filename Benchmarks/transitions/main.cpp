@@ -0,0 +1,189 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "transitionlist.h"
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLTexture>
+#include <QOpenGLBuffer>
+#include <QOpenGLVertexArrayObject>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QPainter>
+#include <QFile>
+#include <QVector2D>
+#include <QVector3D>
+#include <QMatrix4x4>
+
+
+#define SWEEP_FRAMES     60 // Default frames for the 0 -> 1 progress sweep
+
+
+namespace {
+// Two different slides to transition between
+QImage
+testSlide(QSize size, QColor color0, QColor color1) {
+    QImage image(size, QImage::Format_RGBA8888_Premultiplied);
+    QPainter painter(&image);
+    QLinearGradient gradient(0, 0, size.width(), size.height());
+    gradient.setColorAt(0.0, color0);
+    gradient.setColorAt(1.0, color1);
+    painter.fillRect(image.rect(), gradient);
+    painter.setPen(QPen(Qt::black, size.height()/100));
+    for(int x=0; x<size.width(); x+=size.width()/16)
+        painter.drawLine(x, 0, x, size.height());
+    painter.end();
+    return image;
+}
+}
+
+
+int
+main(int argc, char *argv[]) {
+    QGuiApplication a(argc, argv);
+    QTextStream out(stdout);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Slide Show transitions offscreen benchmark");
+    parser.addHelpOption();
+    QCommandLineOption framesOption("frames", "Frames per progress sweep.", "n", QString::number(SWEEP_FRAMES));
+    QCommandLineOption maxOption("max-ms", "Fail if a transition needs more ms/frame.", "ms", "0");
+    QCommandLineOption dirOption("shaders", "The CommonFiles directory.", "dir", COMMON_FILES_DIR);
+    parser.addOption(framesOption);
+    parser.addOption(maxOption);
+    parser.addOption(dirOption);
+    parser.process(a);
+    int nFrames = qMax(parser.value(framesOption).toInt(), 2);
+    double msMax = parser.value(maxOption).toDouble();
+    QString sCommonDir = parser.value(dirOption);
+
+    QOffscreenSurface surface;
+    surface.create();
+    QOpenGLContext context;
+    if(!context.create() || !context.makeCurrent(&surface)) {
+        out << "Unable to create the OpenGL context\n";
+        return 1;
+    }
+    QOpenGLFunctions* f = context.functions();
+    out << "Renderer: " << reinterpret_cast<const char*>(f->glGetString(GL_RENDERER)) << "\n";
+    out << "Version:  " << reinterpret_cast<const char*>(f->glGetString(GL_VERSION)) << "\n";
+
+    // The same meshes used by SlideWidget
+    QVector<TransitionVertex> vertices;
+    QVector<quint16>          indices;
+    MeshRange meshes[nTransitionMeshes];
+    transitionMeshes(&vertices, &indices, meshes);
+
+    QOpenGLVertexArrayObject vao;
+    vao.create(); // Mandatory with core profiles
+    QOpenGLVertexArrayObject::Binder vaoBinder(&vao);
+    QOpenGLBuffer arrayBuf(QOpenGLBuffer::VertexBuffer);
+    arrayBuf.create();
+    arrayBuf.bind();
+    arrayBuf.allocate(vertices.data(), int(vertices.count()*sizeof(TransitionVertex)));
+    QOpenGLBuffer indexBuf(QOpenGLBuffer::IndexBuffer);
+    indexBuf.create();
+    indexBuf.bind();
+    indexBuf.allocate(indices.data(), int(indices.count()*sizeof(quint16)));
+
+    QMatrix4x4 m;
+    m.ortho(-1.0f, +1.0f, -1.0f, 1.0f, 4.0f, 15.0f);
+    m.translate(0.0f, 0.0f, -10.0);
+
+    const QList<QSize> resolutions({QSize(1280, 720), QSize(1920, 1080), QSize(3840, 2160)});
+    const QStringList shaderDirs({"Shaders", "ShadersRPi3", "ShadersRPi4"});
+    const QList<TransitionEntry> transitions = transitionList();
+    bool bFailed = false;
+
+    for(const QSize& size : resolutions) {
+        QOpenGLFramebufferObject fbo(size);
+        fbo.bind();
+        f->glViewport(0, 0, size.width(), size.height());
+        QOpenGLTexture texture0(testSlide(size, Qt::red, Qt::yellow));
+        QOpenGLTexture texture1(testSlide(size, Qt::blue, Qt::green));
+        texture0.bind(0);
+        texture1.bind(1);
+        for(const QString& sDir : shaderDirs) {
+            out << QString("\n%1 %2x%3 [ms/frame]\n").arg(sDir).arg(size.width()).arg(size.height());
+            QString sVertex = QString("%1/%2/vShader.glsl").arg(sCommonDir, sDir);
+            for(const TransitionEntry& entry : transitions) {
+                QString sFragment = QString("%1/%2/%3.glsl").arg(sCommonDir, sDir, entry.sShader);
+                if(!QFile::exists(sFragment))
+                    continue; // Not every transition exists for every platform
+                QOpenGLShaderProgram program;
+                if(!program.addShaderFromSourceFile(QOpenGLShader::Vertex, sVertex) ||
+                   !program.addShaderFromSourceFile(QOpenGLShader::Fragment, sFragment) ||
+                   !program.link() || !program.bind())
+                {
+                    out << QString("%1 not built on this context\n").arg(entry.sShader, -20);
+                    continue;
+                }
+                int iPositionLoc = program.attributeLocation("a_position");
+                int iTexcoordLoc = program.attributeLocation("a_texcoord");
+                int iProgressLoc = program.uniformLocation("progress");
+                program.enableAttributeArray(iPositionLoc);
+                program.setAttributeBuffer(iPositionLoc, GL_FLOAT, 0, 3, sizeof(TransitionVertex));
+                program.enableAttributeArray(iTexcoordLoc);
+                program.setAttributeBuffer(iTexcoordLoc, GL_FLOAT, sizeof(QVector3D), 2, sizeof(TransitionVertex));
+                program.setUniformValue("texture0", 0);
+                program.setUniformValue("texture1", 1);
+                program.setUniformValue("mvp_matrix", m);
+                program.setUniformValue("borderColor", QColor(Qt::white));
+                program.setUniformValue("texRect0", QVector4D(0.0f, 0.0f, 1.0f, 1.0f));
+                program.setUniformValue("texRect1", QVector4D(0.0f, 0.0f, 1.0f, 1.0f));
+                program.setUniformValue("texExtent", QVector4D(1.0f, 1.0f, 1.0f, 1.0f));
+
+                const MeshRange& mesh = meshes[entry.mesh];
+                const void* pFirstIndex = reinterpret_cast<const void*>(quintptr(mesh.iFirstIndex*sizeof(quint16)));
+                // One frame out of the measure: the driver may compile lazily
+                program.setUniformValue(iProgressLoc, 0.0f);
+                f->glDrawElements(GL_TRIANGLES, mesh.nIndices, GL_UNSIGNED_SHORT, pFirstIndex);
+                f->glFinish();
+
+                QElapsedTimer timer;
+                timer.start();
+                for(int i=0; i<nFrames; i++) {
+                    program.setUniformValue(iProgressLoc, GLfloat(i)/GLfloat(nFrames-1));
+                    f->glClear(GL_COLOR_BUFFER_BIT);
+                    f->glDrawElements(GL_TRIANGLES, mesh.nIndices, GL_UNSIGNED_SHORT, pFirstIndex);
+                }
+                f->glFinish();
+                double msFrame = double(timer.nsecsElapsed())/1.0e6/nFrames;
+                QString sResult = QString("%1 %2").arg(entry.sShader, -20).arg(msFrame, 8, 'f', 2);
+                if((msMax > 0.0) && (msFrame > msMax)) {
+                    sResult += "  TOO SLOW";
+                    bFailed = true;
+                }
+                out << sResult << "\n";
+                out.flush();
+                program.release();
+            }
+        }
+        texture0.release(0);
+        texture1.release(1);
+        fbo.release();
+    }
+    context.doneCurrent();
+    return bFailed ? 2 : 0;
+}
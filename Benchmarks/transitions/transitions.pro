@@ -0,0 +1,47 @@
+#Copyright (C) 2023  Gabriele Salvato
+
+#This program is free software: you can redistribute it and/or modify
+#it under the terms of the GNU General Public License as published by
+#the Free Software Foundation, either version 3 of the License, or
+#(at your option) any later version.
+
+#This program is distributed in the hope that it will be useful,
+#but WITHOUT ANY WARRANTY; without even the implied warranty of
+#MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#GNU General Public License for more details.
+
+#You should have received a copy of the GNU General Public License
+#along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+# Renders offscreen every Slide Show transition over a full 0 -> 1
+# progress sweep at 720p, 1080p and 4K with the Shaders, ShadersRPi3
+# and ShadersRPi4 variants and reports the time per frame.
+# Needs no GPU: on a headless box run it with Mesa llvmpipe, e.g.
+#   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run -a ./transitions
+#
+# Options: --frames <n>   frames per sweep (default 60)
+#          --max-ms <ms>  exit with error if a transition is slower
+#          --shaders <dir> the CommonFiles directory
+
+
+QT += core
+QT += gui
+QT += opengl
+
+CONFIG += c++17
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+DEFINES += COMMON_FILES_DIR=\\\"$$clean_path($$PWD/../../CommonFiles)\\\"
+
+INCLUDEPATH += ../../CommonFiles
+
+SOURCES += \
+    ../../CommonFiles/transitionlist.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../CommonFiles/transitionlist.h
@@ -10,6 +10,12 @@ precision highp float;
 
 uniform sampler2D texture0;
 uniform sampler2D texture1;
+#ifdef GPU_LETTERBOX
+uniform vec4 texRect0;      // Slide placement: xy origin, zw size (uv units)
+uniform vec4 texRect1;
+uniform vec4 texExtent;     // Part of texture0 (xy) and texture1 (zw) in use
+uniform vec4 borderColor;
+#endif
 uniform float progress;
 
 varying vec4 v_texcoord;
@@ -17,16 +23,26 @@ varying vec4 v_texcoord;
 
 vec4
 getFromColor(vec2 p) {
-    vec4 tempc;
-    tempc = texture2D(texture0, vec2(p.x, p.y));
-    return tempc;
+#ifdef GPU_LETTERBOX
+    vec2 q = (fract(p) - texRect0.xy) / texRect0.zw;
+    if(q.x < 0.0 || q.x > 1.0 || q.y < 0.0 || q.y > 1.0)
+        return borderColor;
+    return texture2D(texture0, q * texExtent.xy);
+#else
+    return texture2D(texture0, p);
+#endif
 }
 
 vec4
 getToColor(vec2 p) {
-    vec4 tempc;
-    tempc = texture2D(texture1, vec2(p.x, p.y));
-    return tempc;
+#ifdef GPU_LETTERBOX
+    vec2 q = (fract(p) - texRect1.xy) / texRect1.zw;
+    if(q.x < 0.0 || q.x > 1.0 || q.y < 0.0 || q.y > 1.0)
+        return borderColor;
+    return texture2D(texture1, q * texExtent.zw);
+#else
+    return texture2D(texture1, p);
+#endif
 }
 
 
@@ -0,0 +1,17 @@
+#version 100
+// fTicker.glsl
+// Glyphs and background of the score ticker from the
+// (premultiplied) glyph atlas
+
+#ifdef GL_ES
+precision mediump float;
+#endif
+
+uniform sampler2D atlas;
+varying vec2 v_texcoord;
+
+
+void
+main(void) {
+    gl_FragColor = texture2D(atlas, v_texcoord);
+}
@@ -0,0 +1,18 @@
+#version 300 es
+// fTicker.glsl
+// Glyphs and background of the score ticker from the
+// (premultiplied) glyph atlas
+
+#ifdef GL_ES
+precision mediump float;
+#endif
+
+uniform sampler2D atlas;
+in vec2  v_texcoord;
+out vec4 glFragColor;
+
+
+void
+main(void) {
+    glFragColor = texture(atlas, v_texcoord);
+}
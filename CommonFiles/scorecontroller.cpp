@@ -24,24 +24,46 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QScreen>
 #include <QDir>
 #include <QKeyEvent>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QThread>
 #if QT_FEATURE_permissions
 #include <QPermissions>
 #endif
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include <QtBluetooth/qbluetoothlocaldevice.h>
 #include <QtBluetooth/qbluetoothserver.h>
 
 #include "scorecontroller.h"
 #include "slidewidget.h"
+#include "spotindex.h"
+#include "spottranscoder.h"
+#include "slidewindow.h"
 #include "utility.h"
 #include "btserver.h"
 
 
+#define SPOT_START_TIMEOUT   3000           // ms given to the spot player to start
+#define SPOT_STOP_TIMEOUT    3000           // ms given to the spot player to quit before killing it
+#define SPOT_READAHEAD_BYTES (32*1024*1024) // Beginning of the next spot read ahead
+#define READAHEAD_CHUNK      (1024*1024)    // Bytes read at a time without fadvise
+#define READAHEAD_PAUSE      20             // ms between the chunks without fadvise
+
+
 ScoreController::ScoreController(QFile *myLogFile, QWidget *parent)
     : QMainWindow(parent)
     , pLogFile(myLogFile)
     , pSettings(new QSettings("Gabriele Salvato", "Score Controller"))
     , pVideoPlayer(nullptr)
-    , pMySlideWindow(new SlideWidget())
+    , pMySlideWindow(nullptr)
+    , pThreadedSlideWindow(nullptr)
+    , pSpotIndex(new SpotIndex(myLogFile, this))
+    , pSpotTranscoder(new SpotTranscoder(myLogFile, this))
     #ifdef Q_OS_WINDOWS
         , sVideoPlayer(QString("ffplay.exe"))
     #else
@@ -55,8 +77,27 @@ ScoreController::ScoreController(QFile *myLogFile, QWidget *parent)
     setWindowIcon(QIcon(":/CommonFiles/Loghi/water-polo-ball.ico"));
 
     iCurrentSpot = 0;
+    bGaplessSpots = false;
+    nSpotGaps = 0;
+    msSpotGapTotal = 0;
+    msSpotGapMax = 0;
+    spotState = spotIdle;
+    bFirstSpot = false;
+    bSpotReadahead = false;
+    bSpotOpened = false;
+    bWarmStart = false;
+    nColdStarts = 0;
+    nWarmStarts = 0;
+    msColdTotal = 0;
+    msWarmTotal = 0;
+    spotTimer.setSingleShot(true);
+    connect(&spotTimer, SIGNAL(timeout()),
+            this, SLOT(onSpotTimeout()));
+    bInProcessSpots = false;
     pSpotButtonsLayout = CreateSpotButtons();
     connectButtonSignals();
+    connect(pSpotIndex, SIGNAL(indexChanged()),
+            this, SLOT(onSpotIndexChanged()));
 
     initBluetooth();
 
@@ -68,6 +109,8 @@ ScoreController::~ScoreController() {
     if(pMySlideWindow)
         pMySlideWindow->deleteLater();
     pMySlideWindow = nullptr;
+    delete pThreadedSlideWindow;
+    pThreadedSlideWindow = nullptr;
     doProcessCleanup();
 }
 
@@ -77,6 +120,8 @@ ScoreController::closeEvent(QCloseEvent*) {
     if(pMySlideWindow)
         pMySlideWindow->deleteLater();
     pMySlideWindow = nullptr;
+    delete pThreadedSlideWindow;
+    pThreadedSlideWindow = nullptr;
     doProcessCleanup();
 }
 
@@ -176,17 +221,17 @@ ScoreController::doProcessCleanup() {
     if(pMySlideWindow) {
         pMySlideWindow->close();
     }
+    if(pThreadedSlideWindow) {
+        pThreadedSlideWindow->stopSlideShow();
+        pThreadedSlideWindow->hide();
+    }
     if(pVideoPlayer) {
-        pVideoPlayer->disconnect();
-        pVideoPlayer->close();
 #ifdef LOG_MESG
         logMessage(pLogFile,
                    Q_FUNC_INFO,
                    QString("Closing Video Player..."));
 #endif
-        pVideoPlayer->waitForFinished(3000);
-        pVideoPlayer->deleteLater();
-        pVideoPlayer = Q_NULLPTR;
+        discardSpotPlayer();
     }
 }
 
@@ -258,6 +303,7 @@ ScoreController::changeFocus() {
 void
 ScoreController::onButtonSetupClicked() {
     GeneralSetup();
+    pSpotIndex->setDirectory(gsArgs.sSpotDir);
     changeFocus();
 }
 
@@ -274,85 +320,390 @@ ScoreController::SaveStatus() {
 }
 
 
+// Dummy... see WaterPolo Panel
+QWidget*
+ScoreController::scorePanel() {
+    return nullptr;
+}
+
+
+// The score ticker of the Slide Window mirrors the score panel
+void
+ScoreController::setTickerTeam(int iTeam, const QString& sTeam) {
+    if((iTeam < 0) || (iTeam > 1))
+        return;
+    sTickerTeam[iTeam] = sTeam; // For a Slide Window still to come
+    if(pMySlideWindow)
+        pMySlideWindow->setTickerTeam(iTeam, sTeam);
+}
+
+
+void
+ScoreController::setTickerScore(int iTeam, int iScore) {
+    if((iTeam < 0) || (iTeam > 1))
+        return;
+    iTickerScore[iTeam] = iScore;
+    if(pMySlideWindow)
+        pMySlideWindow->setTickerScore(iTeam, iScore);
+}
+
+
 bool
 ScoreController::startSpotLoop() {
-    QDir spotDir(gsArgs.sSpotDir);
-    spotList = QFileInfoList();
-    if(spotDir.exists()) {
-        QStringList nameFilter(QStringList() << "*.mp4" << "*.MP4" << ".mov" << "*.MOV");
-        spotDir.setNameFilters(nameFilter);
-        spotDir.setFilter(QDir::Files);
-        spotList = spotDir.entryInfoList();
-    }
+    pSpotIndex->setDirectory(gsArgs.sSpotDir);
+    spotList = pSpotTranscoder->playableList(pSpotIndex->spotList());
 #ifdef LOG_VERBOSE
     logMessage(pLogFile,
                Q_FUNC_INFO,
                QString("Found %1 spots").arg(spotList.count()));
 #endif
-    if(!spotList.isEmpty()) {
-        iCurrentSpot = iCurrentSpot % spotList.count();
-        if(!pVideoPlayer) {
-            pVideoPlayer = new QProcess(this);
-            connect(pVideoPlayer, SIGNAL(finished(int,QProcess::ExitStatus)),
-                    this, SLOT(onStartNextSpot(int,QProcess::ExitStatus)));
-
-            QStringList sArguments;
-            sArguments = QStringList{"-noborder",
-                                     "-sn",
-                                     "-autoexit",
-                                     "-fs"
-                                    };
-            QList<QScreen*> screens = QApplication::screens();
-            if(screens.count() > 1) {
-                QRect screenres = screens.at(1)->geometry();
-                sArguments.append(QString("-left"));
-                sArguments.append(QString("%1").arg(screenres.x()));
-                sArguments.append(QString("-top"));
-                sArguments.append(QString("%1").arg(screenres.y()));
-                sArguments.append(QString("-x"));
-                sArguments.append(QString("%1").arg(screenres.width()));
-                sArguments.append(QString("-y"));
-                sArguments.append(QString("%1").arg(screenres.height()));
-            }
-            sArguments.append(spotList.at(iCurrentSpot).absoluteFilePath());
-            pVideoPlayer->start(sVideoPlayer, sArguments);
+    if(!spotList.isEmpty() && pSettings->value("spots/inProcess", false).toBool())
+        return startInProcessSpots();
+    if(spotList.isEmpty())
+        return false;
+    if(pVideoPlayer) // Still running or still closing
+        return spotState != spotStopping;
+    bGaplessSpots = pSettings->value("spots/gapless", false).toBool();
+    bSpotReadahead = pSettings->value("spots/readahead", false).toBool();
+    spotGapTime.invalidate(); // No gap before the first spot
+    iCurrentSpot = iCurrentSpot % spotList.count();
+    bFirstSpot = true;
+    return launchSpotPlayer();
+}
+
+
+// The player is only launched here: whether it started or not
+// is known later from its signals (or from the spotTimer).
+// Returns false only if the start failed right away.
+bool
+ScoreController::launchSpotPlayer() {
+    if(!pVideoPlayer) {
+        pVideoPlayer = new QProcess(this);
+        connect(pVideoPlayer, SIGNAL(finished(int,QProcess::ExitStatus)),
+                this, SLOT(onStartNextSpot(int,QProcess::ExitStatus)));
+        connect(pVideoPlayer, SIGNAL(readyReadStandardError()),
+                this, SLOT(onSpotPlayerOutput()));
+        connect(pVideoPlayer, SIGNAL(started()),
+                this, SLOT(onSpotStarted()));
+        connect(pVideoPlayer, SIGNAL(errorOccurred(QProcess::ProcessError)),
+                this, SLOT(onSpotPlayerError(QProcess::ProcessError)));
+    }
+
+    QStringList sArguments;
+    sArguments = QStringList{"-noborder",
+                             "-sn",
+                             "-autoexit",
+                             "-fs"
+                            };
+    QList<QScreen*> screens = QApplication::screens();
+    if(screens.count() > 1) {
+        QRect screenres = screens.at(1)->geometry();
+        sArguments.append(QString("-left"));
+        sArguments.append(QString("%1").arg(screenres.x()));
+        sArguments.append(QString("-top"));
+        sArguments.append(QString("%1").arg(screenres.y()));
+        sArguments.append(QString("-x"));
+        sArguments.append(QString("%1").arg(screenres.width()));
+        sArguments.append(QString("-y"));
+        sArguments.append(QString("%1").arg(screenres.height()));
+    }
+    bSpotOpened = false;
+    appendSpotInput(&sArguments);
+    sStartingSpot = sArguments.last();
+    // Warm only if the file given to the player is the one read ahead
+    bWarmStart = !sReadaheadSpot.isEmpty() && (sStartingSpot == sReadaheadSpot);
+    sReadaheadSpot.clear();
+    spotState = spotStarting;
+    spotStartTime.start();
+    spotTimer.start(SPOT_START_TIMEOUT);
+    pVideoPlayer->start(sVideoPlayer, sArguments);
+    return pVideoPlayer != nullptr;
+}
+
+
+void
+ScoreController::onSpotStarted() {
+    spotTimer.stop();
+    spotState = spotPlaying;
+    bFirstSpot = false;
+#ifdef LOG_MESG
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("Spot player started in %1 ms: %2")
+               .arg(spotStartTime.elapsed())
+               .arg(sStartingSpot));
+#endif
+}
+
+
+// Only the failure to start needs care here: after the
+// other errors the player emits finished() as well.
+void
+ScoreController::onSpotPlayerError(QProcess::ProcessError error) {
+    if((error == QProcess::FailedToStart) && (spotState == spotStarting))
+        spotStartFailed();
+}
+
+
+void
+ScoreController::onSpotTimeout() {
+    if(!pVideoPlayer)
+        return;
+    if(spotState == spotStarting) {
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Spot player not started in %1 ms").arg(SPOT_START_TIMEOUT));
+        spotStartFailed();
+    }
+    else if(spotState == spotStopping) {
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Spot player not closed in %1 ms: killing it").arg(SPOT_STOP_TIMEOUT));
+        pVideoPlayer->kill(); // finished() will follow
+    }
+}
 
+
+void
+ScoreController::spotStartFailed() {
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("Impossibile mandare lo spot."));
+    discardSpotPlayer();
+    if(bFirstSpot) {
+        bFirstSpot = false;
+        QMessageBox::critical(this, tr("Impossibile mandare lo spot !"),
+                              tr("Il programma %1 é stato installato ?")
+                                  .arg(sVideoPlayer));
+    }
+    if(myStatus == showSpots)
+        onButtonSpotLoopClicked(); // Back to the score panel
+}
+
+
+// The player is killed and left to delete itself once it
+// is over: nobody waits for it.
+void
+ScoreController::discardSpotPlayer() {
+    spotTimer.stop();
+    spotState = spotIdle;
+    if(!pVideoPlayer)
+        return;
+    pVideoPlayer->disconnect();
+    if(pVideoPlayer->state() == QProcess::NotRunning) {
+        pVideoPlayer->deleteLater();
+    }
+    else {
+        connect(pVideoPlayer, SIGNAL(finished(int,QProcess::ExitStatus)),
+                pVideoPlayer, SLOT(deleteLater()));
+        connect(pVideoPlayer, SIGNAL(errorOccurred(QProcess::ProcessError)),
+                pVideoPlayer, SLOT(deleteLater()));
+        pVideoPlayer->kill();
+    }
+    pVideoPlayer = nullptr;
+}
+
+
+// One spot for each player run or, gapless, the whole list through
+// the concat demuxer: the player is then restarted (and the spot
+// directory scanned again) only at the end of every round.
+// The spots should share codec and resolution to play gapless.
+void
+ScoreController::appendSpotInput(QStringList* pArguments) {
+    if(bGaplessSpots) {
+        QString sPlaylist = writeSpotPlaylist();
+        if(!sPlaylist.isEmpty()) {
+            pArguments->append(QStringList{"-f", "concat", "-safe", "0", sPlaylist});
 #ifdef LOG_VERBOSE
             logMessage(pLogFile,
                        Q_FUNC_INFO,
-                       QString("Now playing: %1")
+                       QString("Now playing %1 spots from: %2")
+                       .arg(spotList.count())
                        .arg(spotList.at(iCurrentSpot).absoluteFilePath()));
 #endif
-            iCurrentSpot = (iCurrentSpot+1) % spotList.count();// Prepare Next Spot
-            if(!pVideoPlayer->waitForStarted(3000)) {
-                pVideoPlayer->close();
-                logMessage(pLogFile,
-                           Q_FUNC_INFO,
-                           QString("Impossibile mandare lo spot."));
-                QMessageBox::critical(this, tr("Impossibile mandare lo spot !"),
-                                      tr("Il programma %1 é stato installato ?")
-                                          .arg(sVideoPlayer));
-                pVideoPlayer->disconnect();
-                delete pVideoPlayer;
-                pVideoPlayer = nullptr;
-                return false;
-            }
-        } // if(!videoPlayer)
-    } // if(!spotList.isEmpty())
-    else
+            return; // Next round from the same spot
+        }
+    }
+    pArguments->append(spotList.at(iCurrentSpot).absoluteFilePath());
+#ifdef LOG_VERBOSE
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("Now playing: %1")
+               .arg(spotList.at(iCurrentSpot).absoluteFilePath()));
+#endif
+    iCurrentSpot = (iCurrentSpot+1) % spotList.count();// Prepare Next Spot
+}
+
+
+// The spot list, starting from the current spot, as an ffconcat
+// playlist. Returns the playlist file name or an empty string.
+QString
+ScoreController::writeSpotPlaylist() {
+    QString sDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if(!QDir().mkpath(sDir))
+        return QString();
+    QString sPlaylist = sDir + QString("/spots.ffconcat");
+    QSaveFile file(sPlaylist);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to write %1").arg(sPlaylist));
+        return QString();
+    }
+    QTextStream playlist(&file);
+    playlist << "ffconcat version 1.0\n";
+    for(int i=0; i<spotList.count(); i++) {
+        QString sSpot = spotList.at((iCurrentSpot+i) % spotList.count()).absoluteFilePath();
+        sSpot.replace("'", "'\\''");
+        playlist << "file '" << sSpot << "'\n";
+    }
+    playlist.flush();
+    if(!file.commit())
+        return QString();
+    return sPlaylist;
+}
+
+
+// The first "Input #" tells that the player has opened the spot.
+// The opening time is logged apart for the spots read ahead
+// (warm) and the others (cold), then the next spot is read ahead.
+// The gap is measured from the exit of the previous player to
+// the moment the new one has opened its input: the panel stays
+// black at least that long.
+void
+ScoreController::onSpotPlayerOutput() {
+    if(!pVideoPlayer)
+        return;
+    QByteArray output = pVideoPlayer->readAllStandardError();
+    if(bSpotOpened || !output.contains("Input #"))
+        return;
+    bSpotOpened = true;
+    qint64 msOpen = spotStartTime.elapsed();
+    if(bWarmStart) {
+        nWarmStarts++;
+        msWarmTotal += msOpen;
+    }
+    else {
+        nColdStarts++;
+        msColdTotal += msOpen;
+    }
+#ifdef LOG_MESG
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("Spot opened in %1 ms, %2 start (mean cold %3 ms over %4, warm %5 ms over %6)")
+               .arg(msOpen)
+               .arg(bWarmStart ? "warm" : "cold")
+               .arg(nColdStarts ? msColdTotal/nColdStarts : 0)
+               .arg(nColdStarts)
+               .arg(nWarmStarts ? msWarmTotal/nWarmStarts : 0)
+               .arg(nWarmStarts));
+#endif
+    // Gapless the concat demuxer opens the next spots by itself
+    if(bSpotReadahead && !bGaplessSpots)
+        readaheadSpot(nextPlayableSpot());
+    if(!spotGapTime.isValid())
+        return;
+    qint64 msGap = spotGapTime.elapsed();
+    spotGapTime.invalidate();
+    nSpotGaps++;
+    msSpotGapTotal += msGap;
+    msSpotGapMax = qMax(msSpotGapMax, msGap);
+#ifdef LOG_MESG
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("Spot gap: %1 ms (mean %2 ms, max %3 ms over %4 gaps)")
+               .arg(msGap)
+               .arg(msSpotGapTotal/nSpotGaps)
+               .arg(msSpotGapMax)
+               .arg(nSpotGaps));
+#endif
+}
+
+
+// The file onStartNextSpot() will play as things stand now: a
+// transcode finished meanwhile replaces the original spot.
+QString
+ScoreController::nextPlayableSpot() const {
+    QFileInfoList nextList = pSpotTranscoder->playableList(pSpotIndex->spotList());
+    if(nextList.isEmpty())
+        return QString();
+    return nextList.at(iCurrentSpot % nextList.count()).absoluteFilePath();
+}
+
+
+// Pulls the beginning of the next spot into the page cache while
+// the current one plays: on the SD card based panels the spot then
+// starts from RAM. Without posix_fadvise() a throttled read does
+// the same.
+void
+ScoreController::readaheadSpot(const QString& sSpot) {
+    sReadaheadSpot = sSpot;
+    if(sSpot.isEmpty())
+        return;
+    QThreadPool::globalInstance()->start([sSpot]() {
+#ifdef Q_OS_LINUX
+        int fd = ::open(QFile::encodeName(sSpot).constData(), O_RDONLY);
+        if(fd < 0)
+            return;
+        posix_fadvise(fd, 0, SPOT_READAHEAD_BYTES, POSIX_FADV_WILLNEED);
+        ::close(fd);
+#else
+        QFile file(sSpot);
+        if(!file.open(QIODevice::ReadOnly))
+            return;
+        qint64 nBytes = 0;
+        while(nBytes < SPOT_READAHEAD_BYTES) {
+            QByteArray chunk = file.read(READAHEAD_CHUNK);
+            if(chunk.isEmpty())
+                break;
+            nBytes += chunk.size();
+            QThread::msleep(READAHEAD_PAUSE);
+        }
+#endif
+    });
+}
+
+
+// The spots are decoded in process and shown by the Slide Window:
+// no player start up, no black gaps and the slide transitions.
+bool
+ScoreController::startInProcessSpots() {
+    slideWidget();
+    iCurrentSpot = iCurrentSpot % spotList.count();
+    pMySlideWindow->setScoreTicker(pSettings->value("slideshow/scoreTicker", false).toBool());
+    pMySlideWindow->setScorePanel(scorePanel());
+    pMySlideWindow->showFullScreen();
+    if(!pMySlideWindow->startSpotShow(spotList, iCurrentSpot)) {
+        pMySlideWindow->hide();
         return false;
+    }
+    bInProcessSpots = true;
     return true;
 }
 
 
 void
 ScoreController::stopSpotLoop() {
-    if(pVideoPlayer) {
-        pVideoPlayer->disconnect();
-        connect(pVideoPlayer, SIGNAL(finished(int,QProcess::ExitStatus)),
-                this, SLOT(onSpotClosed(int,QProcess::ExitStatus)));
-        pVideoPlayer->terminate();
+    if(bInProcessSpots) {
+        iCurrentSpot = pMySlideWindow->currentSpot() + 1; // Next time
+        pMySlideWindow->stopSpotShow();
+        pMySlideWindow->hide();
+        bInProcessSpots = false;
+        return;
     }
+    if(!pVideoPlayer || (spotState == spotStopping))
+        return;
+    if(spotState == spotStarting) { // Nothing to close gently yet
+        bFirstSpot = false;
+        discardSpotPlayer();
+        return;
+    }
+    pVideoPlayer->disconnect();
+    connect(pVideoPlayer, SIGNAL(finished(int,QProcess::ExitStatus)),
+            this, SLOT(onSpotClosed(int,QProcess::ExitStatus)));
+    spotState = spotStopping;
+    spotTimer.start(SPOT_STOP_TIMEOUT);
+    pVideoPlayer->terminate();
 }
 
 
@@ -360,15 +711,21 @@ bool
 ScoreController::startSlideShow() {
     if(pVideoPlayer)
         return false;// No Slide Show if movies are playing or camera is active
-    if(!pMySlideWindow) {
-        logMessage(pLogFile,
-                   Q_FUNC_INFO,
-                   QString("Invalid Slide Window"));
-        return false;
-    }
+    if(pSettings->value("slideshow/renderThread", false).toBool())
+        return startThreadedSlideShow();
+    slideWidget();
     if(!pMySlideWindow->setSlideDir(gsArgs.sSlideDir)) {
         return false;
     }
+    pMySlideWindow->setPboUpload(pSettings->value("slideshow/pboUpload", false).toBool());
+    pMySlideWindow->setGpuLetterbox(pSettings->value("slideshow/gpuLetterbox", false).toBool());
+    pMySlideWindow->setSlideCache(pSettings->value("slideshow/slideCache", false).toBool());
+    pMySlideWindow->setTextureCompression(pSettings->value("slideshow/textureCompression", false).toBool());
+    pMySlideWindow->setStatsOverlay(pSettings->value("slideshow/statsOverlay", false).toBool());
+    pMySlideWindow->setMemoryBudget(pSettings->value("slideshow/memoryBudget", 0).toInt());
+    pMySlideWindow->setScoreTicker(pSettings->value("slideshow/scoreTicker", false).toBool());
+    pMySlideWindow->setTransitionDuration(pSettings->value("slideshow/transitionTime", 1500).toInt());
+    pMySlideWindow->setScorePanel(scorePanel());
     pMySlideWindow->showFullScreen();
     if(!pMySlideWindow->startSlideShow()) {
         pMySlideWindow->hide();
@@ -378,12 +735,61 @@ ScoreController::startSlideShow() {
 }
 
 
+// The Slide Show is rendered by its own thread: the controller
+// events never delay a frame and the frames never delay them.
+bool
+ScoreController::startThreadedSlideShow() {
+    if(!pThreadedSlideWindow) {
+        // The Slide Widget would keep a second prefetcher alive
+        if(pMySlideWindow)
+            pMySlideWindow->deleteLater();
+        pMySlideWindow = nullptr;
+        pThreadedSlideWindow = new SlideWindow(pLogFile);
+    }
+    if(!pThreadedSlideWindow->setSlideDir(gsArgs.sSlideDir)) {
+        return false;
+    }
+    pThreadedSlideWindow->setGpuLetterbox(pSettings->value("slideshow/gpuLetterbox", false).toBool());
+    pThreadedSlideWindow->setSlideCache(pSettings->value("slideshow/slideCache", false).toBool());
+    pThreadedSlideWindow->setTransitionDuration(pSettings->value("slideshow/transitionTime", 1500).toInt());
+    pThreadedSlideWindow->setScorePanel(scorePanel());
+    pThreadedSlideWindow->showFullScreen();
+    if(!pThreadedSlideWindow->startSlideShow()) {
+        pThreadedSlideWindow->hide();
+        return false;
+    }
+    return true;
+}
+
+
+// The Slide Widget is created on first use: the score panel alone
+// runs no prefetcher thread. Only one of the two Slide Show windows,
+// and then only one prefetcher, exists at any time.
+SlideWidget*
+ScoreController::slideWidget() {
+    if(pMySlideWindow)
+        return pMySlideWindow;
+    delete pThreadedSlideWindow;
+    pThreadedSlideWindow = nullptr;
+    pMySlideWindow = new SlideWidget(pLogFile);
+    for(int iTeam=0; iTeam<2; iTeam++) {
+        pMySlideWindow->setTickerTeam(iTeam, sTickerTeam[iTeam]);
+        pMySlideWindow->setTickerScore(iTeam, iTickerScore[iTeam]);
+    }
+    return pMySlideWindow;
+}
+
+
 void
 ScoreController::stopSlideShow() {
     if(pMySlideWindow) {
         pMySlideWindow->stopSlideShow();
         pMySlideWindow->hide();
     }
+    if(pThreadedSlideWindow && pThreadedSlideWindow->isVisible()) {
+        pThreadedSlideWindow->stopSlideShow();
+        pThreadedSlideWindow->hide();
+    }
 }
 
 
@@ -498,10 +904,11 @@ void
 ScoreController::onSpotClosed(int exitCode, QProcess::ExitStatus exitStatus) {
     Q_UNUSED(exitCode);
     Q_UNUSED(exitStatus);
+    spotTimer.stop();
+    spotState = spotIdle;
     if(pVideoPlayer) {
         pVideoPlayer->disconnect();
-        pVideoPlayer->close();// Closes all communication with the process and kills it.
-        delete pVideoPlayer;
+        pVideoPlayer->deleteLater();// We are inside one of its signals
         pVideoPlayer = nullptr;
     } // if(pVideoPlayer)
 }
@@ -511,72 +918,42 @@ void
 ScoreController::onStartNextSpot(int exitCode, QProcess::ExitStatus exitStatus) {
     Q_UNUSED(exitCode);
     Q_UNUSED(exitStatus);
-    // Update spot list just in case we are updating the spot list...
-    QDir spotDir(gsArgs.sSpotDir);
-    spotList = QFileInfoList();
-    QStringList nameFilter(QStringList() << "*.mp4" << "*.MP4" << ".mov" << "*.MOV");
-    spotDir.setNameFilters(nameFilter);
-    spotDir.setFilter(QDir::Files);
-    spotList = spotDir.entryInfoList();
+    spotGapTime.start(); // The screen is black from now on
+    // No directory scan between the spots: the index follows
+    // the changes of the spot directory by itself.
+    spotList = pSpotTranscoder->playableList(pSpotIndex->spotList());
     if(spotList.count() == 0) {
 #ifdef LOG_VERBOSE
         logMessage(pLogFile,
                    Q_FUNC_INFO,
                    QString("No spots available !"));
 #endif
-        if(pVideoPlayer) {
-            pVideoPlayer->disconnect();
-            delete pVideoPlayer;
-            pVideoPlayer = nullptr;
-        }
+        discardSpotPlayer();
         return;
     }
-
     iCurrentSpot = iCurrentSpot % spotList.count();
-    if(!pVideoPlayer) {
-        pVideoPlayer = new QProcess(this);
-        connect(pVideoPlayer, SIGNAL(finished(int,QProcess::ExitStatus)),
-                this, SLOT(onStartNextSpot(int,QProcess::ExitStatus)));
-    }
+    launchSpotPlayer();
+}
 
-    QStringList sArguments;
-    sArguments = QStringList{"-noborder",
-                             "-sn",
-                             "-autoexit",
-                             "-fs"
-                            };
-    QList<QScreen*> screens = QApplication::screens();
-    if(screens.count() > 1) {
-        QRect screenres = screens.at(1)->geometry();
-        sArguments.append(QString("-left"));
-        sArguments.append(QString("%1").arg(screenres.x()));
-        sArguments.append(QString("-top"));
-        sArguments.append(QString("%1").arg(screenres.y()));
-        sArguments.append(QString("-x"));
-        sArguments.append(QString("%1").arg(screenres.width()));
-        sArguments.append(QString("-y"));
-        sArguments.append(QString("%1").arg(screenres.height()));
-    }
-    sArguments.append(spotList.at(iCurrentSpot).absoluteFilePath());
 
-    pVideoPlayer->start(sVideoPlayer, sArguments);
-#ifdef LOG_VERBOSE
-    logMessage(pLogFile,
-               Q_FUNC_INFO,
-               QString("Now playing: %1")
-               .arg(spotList.at(iCurrentSpot).absoluteFilePath()));
-#endif
-    iCurrentSpot = (iCurrentSpot+1) % spotList.count();// Prepare Next Spot
-    if(!pVideoPlayer->waitForStarted(3000)) {
-        pVideoPlayer->close();
-        logMessage(pLogFile,
-                   Q_FUNC_INFO,
-                   QString("Impossibile mandare lo spot"));
-        pVideoPlayer->disconnect();
-        delete pVideoPlayer;
-        pVideoPlayer = Q_NULLPTR;
-        return;
+// The spot button tells how long a whole round of spots lasts.
+// The spots not suited to the panel are converted in background.
+void
+ScoreController::onSpotIndexChanged() {
+    if(pSettings->value("spots/transcode", false).toBool()) {
+        QList<QScreen*> screens = QApplication::screens();
+        QSize panelSize = screens.at(screens.count() > 1 ? 1 : 0)->geometry().size();
+        pSpotTranscoder->setLimits(pSettings->value("spots/transcodeThreads", 1).toInt(),
+                                   pSettings->value("spots/transcodeNice", 19).toInt());
+        pSpotTranscoder->update(pSpotIndex->directory(),
+                                pSpotIndex->spots(),
+                                panelSize);
     }
+    qint64 msLoop = pSpotIndex->totalDuration();
+    pSpotButton->setText(msLoop > 0 ? SpotIndex::formatDuration(msLoop) : QString());
+    pSpotButton->setToolTip(QString("Start/Stop Spot Loop (%1 spots, %2)")
+                            .arg(pSpotIndex->spots().count())
+                            .arg(SpotIndex::formatDuration(msLoop)));
 }
 
 
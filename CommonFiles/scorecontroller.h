@@ -24,6 +24,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QSettings>
 #include <QProcess>
 #include <QFileInfoList>
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QBluetoothLocalDevice>
 #include <QBluetoothHostInfo>
 
@@ -34,6 +36,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 QT_FORWARD_DECLARE_CLASS(QHBoxLayout)
 QT_FORWARD_DECLARE_CLASS(QPushButton)
 QT_FORWARD_DECLARE_CLASS(SlideWidget)
+QT_FORWARD_DECLARE_CLASS(SlideWindow)
+QT_FORWARD_DECLARE_CLASS(SpotIndex)
+QT_FORWARD_DECLARE_CLASS(SpotTranscoder)
 QT_FORWARD_DECLARE_CLASS(BtServer)
 
 
@@ -52,6 +57,11 @@ protected slots:
     void onButtonShutdownClicked();
     void onSpotClosed(int exitCode, QProcess::ExitStatus exitStatus);
     void onStartNextSpot(int exitCode, QProcess::ExitStatus exitStatus);
+    void onSpotPlayerOutput();
+    void onSpotStarted();
+    void onSpotPlayerError(QProcess::ProcessError error);
+    void onSpotTimeout();
+    void onSpotIndexChanged();
     void closeEvent(QCloseEvent*) override;
 
 private slots:
@@ -74,13 +84,26 @@ protected:
     QHBoxLayout*    CreateSpotButtons();
     void            connectButtonSignals();
     bool            startSlideShow();
+    bool            startThreadedSlideShow();
+    SlideWidget*    slideWidget();
     void            stopSlideShow();
     bool            startSpotLoop();
+    bool            startInProcessSpots();
     void            stopSpotLoop();
+    QString         writeSpotPlaylist();
+    void            appendSpotInput(QStringList* pArguments);
+    void            readaheadSpot(const QString& sSpot);
+    QString         nextPlayableSpot() const;
+    bool            launchSpotPlayer();
+    void            spotStartFailed();
+    void            discardSpotPlayer();
     void            disableGeneralButtons();
     void            enableGeneralButtons();
     virtual void    SaveStatus();
     virtual void    GeneralSetup();
+    virtual QWidget* scorePanel();
+    void            setTickerTeam(int iTeam, const QString& sTeam);
+    void            setTickerScore(int iTeam, int iScore);
     void            doProcessCleanup();
     QString         XML_Parse(const QString& input_string, const QString& token);
     virtual void    processBtMessage(QString sMessage);
@@ -101,13 +124,38 @@ protected:
     QString         sProcess;
     QString         sProcessArguments;
     SlideWidget*    pMySlideWindow;
+    SlideWindow*    pThreadedSlideWindow;
+    QString         sTickerTeam[2];
+    int             iTickerScore[2]{};
     QFileInfoList   spotList;
-    struct spot {
-        QString spotFilename;
-        qint64  spotFileSize;
-    };
-    QList<spot>        availabeSpotList;
+    SpotIndex*      pSpotIndex;
+    SpotTranscoder* pSpotTranscoder;
+    bool               bInProcessSpots;
     int                iCurrentSpot;
+    bool               bGaplessSpots;
+    QElapsedTimer      spotGapTime;
+    int                nSpotGaps;
+    qint64             msSpotGapTotal;
+    qint64             msSpotGapMax;
+    enum spotPlayerState {
+        spotIdle,
+        spotStarting,
+        spotPlaying,
+        spotStopping
+    };
+    spotPlayerState    spotState;
+    QTimer             spotTimer;
+    QElapsedTimer      spotStartTime;
+    QString            sStartingSpot;
+    bool               bFirstSpot;
+    bool               bSpotReadahead;
+    bool               bSpotOpened;
+    bool               bWarmStart;
+    QString            sReadaheadSpot;
+    int                nColdStarts;
+    int                nWarmStarts;
+    qint64             msColdTotal;
+    qint64             msWarmTotal;
     QString            sVideoPlayer;
     BtServer*          pBtServer;
     QString            sLocalName;
@@ -0,0 +1,296 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "scoreticker.h"
+
+#include <QImage>
+#include <QPainter>
+#include <QFont>
+#include <QFontMetrics>
+#include <QDebug>
+
+
+#define TICKER_GLYPHS    "0123456789-" // Glyphs for the scores
+#define MAX_TICKER_QUADS            16 // Background + 2 names + "99 - 99" + spare
+#define TICKER_HEIGHT_RATIO         14 // Bar height as a fraction of the panel height
+#define MAX_NAME_WIDTH_RATIO         3 // Team names are clipped to this fraction of the panel width
+
+
+ScoreTicker::ScoreTicker()
+    : pProgram(nullptr)
+    , pAtlas(nullptr)
+    , pVao(nullptr)
+    , vertexBuf(QOpenGLBuffer::VertexBuffer)
+    , iPositionLoc(-1)
+    , iTexcoordLoc(-1)
+    , sGlyphs(TICKER_GLYPHS)
+    , iBarHeight(0)
+    , nVertices(0)
+    , bAtlasDirty(true)
+    , bQuadsDirty(true)
+{
+    iScore[0] = 0;
+    iScore[1] = 0;
+}
+
+
+// Must be called with the OpenGL context current
+bool
+ScoreTicker::initialize(const QString& sShaderDir, QSize newPanelSize) {
+    initializeOpenGLFunctions();
+    panelSize  = newPanelSize;
+    iBarHeight = qMax(panelSize.height()/TICKER_HEIGHT_RATIO, 16);
+
+    pProgram = new QOpenGLShaderProgram();
+    if(!pProgram->addCacheableShaderFromSourceFile(QOpenGLShader::Vertex, QString(":%1/vTicker.glsl").arg(sShaderDir)) ||
+       !pProgram->addCacheableShaderFromSourceFile(QOpenGLShader::Fragment, QString(":%1/fTicker.glsl").arg(sShaderDir)) ||
+       !pProgram->link())
+    {
+        qCritical() << __FUNCTION__ << __LINE__ << "Unable to build the ticker shaders";
+        delete pProgram;
+        pProgram = nullptr;
+        return false;
+    }
+    iPositionLoc = pProgram->attributeLocation("a_position");
+    iTexcoordLoc = pProgram->attributeLocation("a_texcoord");
+    pProgram->bind();
+    pProgram->setUniformValue("atlas", 0);
+    pProgram->release();
+
+    // Room for the longest score: only rewritten afterwards
+    vertexBuf.create();
+    vertexBuf.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    vertexBuf.bind();
+    vertexBuf.allocate(int(MAX_TICKER_QUADS*6*sizeof(TickerVertex)));
+
+    pVao = new QOpenGLVertexArrayObject();
+    if(pVao->create()) {
+        QOpenGLVertexArrayObject::Binder vaoBinder(pVao);
+        vertexBuf.bind();
+        setVertexAttributes();
+    }
+    else { // OpenGL ES 2.0 without OES_vertex_array_object
+        delete pVao;
+        pVao = nullptr;
+    }
+    vertexBuf.release();
+    bAtlasDirty = true;
+    bQuadsDirty = true;
+    return true;
+}
+
+
+void
+ScoreTicker::setVertexAttributes() {
+    pProgram->enableAttributeArray(iPositionLoc);
+    pProgram->setAttributeBuffer(iPositionLoc, GL_FLOAT, 0, 2, sizeof(TickerVertex));
+    pProgram->enableAttributeArray(iTexcoordLoc);
+    pProgram->setAttributeBuffer(iTexcoordLoc, GL_FLOAT, 2*sizeof(GLfloat), 2, sizeof(TickerVertex));
+}
+
+
+// Team names change rarely: the atlas is rebuilt only then
+void
+ScoreTicker::setTeam(int iTeam, const QString& sNewTeam) {
+    if((iTeam < 0) || (iTeam > 1) || (sTeam[iTeam] == sNewTeam))
+        return;
+    sTeam[iTeam] = sNewTeam;
+    bAtlasDirty = true;
+}
+
+
+void
+ScoreTicker::setScore(int iTeam, int iNewScore) {
+    if((iTeam < 0) || (iTeam > 1) || (iScore[iTeam] == iNewScore))
+        return;
+    iScore[iTeam] = iNewScore;
+    bQuadsDirty = true;
+}
+
+
+// The atlas holds a translucent block for the bar background,
+// the score glyphs in the first row and the two team names
+// in the following ones. White glyphs, premultiplied alpha.
+// Must be called with the OpenGL context current.
+void
+ScoreTicker::buildAtlas() {
+    QFont font("Sans");
+    font.setBold(true);
+    font.setPixelSize(iBarHeight*3/4);
+    QFontMetrics metrics(font);
+    int iRowHeight = iBarHeight;
+    int iMaxName   = panelSize.width()/MAX_NAME_WIDTH_RATIO;
+    int iNameWidth[2];
+    for(int i=0; i<2; i++)
+        iNameWidth[i] = qMin(metrics.horizontalAdvance(sTeam[i])+iRowHeight/2, iMaxName);
+    int iGlyphsWidth = iRowHeight; // The background block comes first
+    for(const QChar& glyph : std::as_const(sGlyphs))
+        iGlyphsWidth += metrics.horizontalAdvance(glyph) + 2;
+    int iWidth = qMax(iGlyphsWidth, qMax(iNameWidth[0], iNameWidth[1]));
+
+    QImage atlasImage(iWidth, 3*iRowHeight, QImage::Format_RGBA8888_Premultiplied);
+    atlasImage.fill(Qt::transparent);
+    QPainter painter(&atlasImage);
+    painter.setFont(font);
+    painter.setPen(Qt::white);
+    painter.fillRect(0, 0, iRowHeight, iRowHeight, QColor(0, 0, 0, 176));
+    // Sample well inside the block: no filtering with the glyphs around
+    backgroundRect = QRectF(iRowHeight/4.0, iRowHeight/4.0, iRowHeight/2.0, iRowHeight/2.0);
+    glyphRects.clear();
+    int x = iRowHeight;
+    for(const QChar& glyph : std::as_const(sGlyphs)) {
+        int iAdvance = metrics.horizontalAdvance(glyph);
+        QRect cell(x+1, 0, iAdvance, iRowHeight);
+        painter.drawText(cell, Qt::AlignCenter, QString(glyph));
+        glyphRects.append(QRectF(cell));
+        x += iAdvance + 2;
+    }
+    for(int i=0; i<2; i++) {
+        QRect cell(0, (i+1)*iRowHeight, iNameWidth[i], iRowHeight);
+        QString sName = metrics.elidedText(sTeam[i], Qt::ElideRight, cell.width()-iRowHeight/2);
+        painter.drawText(cell, Qt::AlignCenter, sName);
+        teamRects[i] = QRectF(cell);
+    }
+    painter.end();
+
+    if(pAtlas)
+        delete pAtlas;
+    pAtlas = new QOpenGLTexture(QOpenGLTexture::Target2D);
+    pAtlas->setFormat(QOpenGLTexture::RGBA8_UNorm);
+    pAtlas->setSize(atlasImage.width(), atlasImage.height());
+    pAtlas->setMipLevels(1);
+    pAtlas->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+    pAtlas->setMinificationFilter(QOpenGLTexture::Linear);
+    pAtlas->setMagnificationFilter(QOpenGLTexture::Linear);
+    pAtlas->setWrapMode(QOpenGLTexture::ClampToEdge);
+    pAtlas->bind();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                    atlasImage.width(), atlasImage.height(),
+                    GL_RGBA, GL_UNSIGNED_BYTE,
+                    atlasImage.constBits());
+    pAtlas->release();
+    bAtlasDirty = false;
+    bQuadsDirty = true;
+}
+
+
+// screenRect in panel pixels (top-down), atlasRect in atlas pixels
+void
+ScoreTicker::addQuad(QVector<TickerVertex>* pVertices, QRectF screenRect, QRectF atlasRect) {
+    GLfloat x0 = GLfloat(2.0*screenRect.left()  /panelSize.width()  - 1.0);
+    GLfloat x1 = GLfloat(2.0*screenRect.right() /panelSize.width()  - 1.0);
+    GLfloat y0 = GLfloat(1.0 - 2.0*screenRect.top()   /panelSize.height());
+    GLfloat y1 = GLfloat(1.0 - 2.0*screenRect.bottom()/panelSize.height());
+    // The atlas rows are uploaded top-down: v = 0 is its first row
+    GLfloat u0 = GLfloat(atlasRect.left()  /pAtlas->width());
+    GLfloat u1 = GLfloat(atlasRect.right() /pAtlas->width());
+    GLfloat v0 = GLfloat(atlasRect.top()   /pAtlas->height());
+    GLfloat v1 = GLfloat(atlasRect.bottom()/pAtlas->height());
+    pVertices->append({x0, y1, u0, v1});
+    pVertices->append({x1, y1, u1, v1});
+    pVertices->append({x1, y0, u1, v0});
+    pVertices->append({x0, y1, u0, v1});
+    pVertices->append({x1, y0, u1, v0});
+    pVertices->append({x0, y0, u0, v0});
+}
+
+
+// Team0  12 - 7  Team1, centered at the bottom of the panel
+void
+ScoreTicker::buildQuads() {
+    QString sScore = QString("%1-%2").arg(iScore[0]).arg(iScore[1]);
+    QVector<QRectF> scoreGlyphs;
+    double scoreWidth = 0.0;
+    for(const QChar& glyph : std::as_const(sScore)) {
+        int iGlyph = sGlyphs.indexOf(glyph);
+        if(iGlyph < 0)
+            continue;
+        scoreGlyphs.append(glyphRects.at(iGlyph));
+        scoreWidth += glyphRects.at(iGlyph).width();
+    }
+    double gap = iBarHeight/2.0;
+    double barWidth = teamRects[0].width() + scoreWidth + teamRects[1].width() + 4.0*gap;
+    double x = (panelSize.width() - barWidth) / 2.0;
+    double y = panelSize.height() - 1.5*iBarHeight;
+
+    QVector<TickerVertex> vertices;
+    addQuad(&vertices, QRectF(x, y, barWidth, iBarHeight), backgroundRect);
+    x += gap;
+    addQuad(&vertices, QRectF(x, y, teamRects[0].width(), iBarHeight), teamRects[0]);
+    x += teamRects[0].width() + gap;
+    for(int i=0; (i<scoreGlyphs.count()) && (vertices.count() < (MAX_TICKER_QUADS-1)*6); i++) {
+        const QRectF& glyphRect = scoreGlyphs.at(i);
+        addQuad(&vertices, QRectF(x, y, glyphRect.width(), iBarHeight), glyphRect);
+        x += glyphRect.width();
+    }
+    x += gap;
+    addQuad(&vertices, QRectF(x, y, teamRects[1].width(), iBarHeight), teamRects[1]);
+
+    nVertices = int(vertices.count());
+    vertexBuf.bind();
+    vertexBuf.write(0, vertices.constData(), int(nVertices*sizeof(TickerVertex)));
+    vertexBuf.release();
+    bQuadsDirty = false;
+}
+
+
+// Drawn after the transition: no depth test,
+// premultiplied alpha blending over the slides.
+// Must be called with the OpenGL context current.
+void
+ScoreTicker::draw() {
+    if(!pProgram)
+        return;
+    if(bAtlasDirty)
+        buildAtlas();
+    if(bQuadsDirty)
+        buildQuads();
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    pAtlas->bind(0);
+    pProgram->bind();
+    if(pVao) {
+        QOpenGLVertexArrayObject::Binder vaoBinder(pVao);
+        glDrawArrays(GL_TRIANGLES, 0, nVertices);
+    }
+    else {
+        vertexBuf.bind();
+        setVertexAttributes();
+        glDrawArrays(GL_TRIANGLES, 0, nVertices);
+        vertexBuf.release();
+    }
+    pProgram->release();
+    pAtlas->release();
+    glDisable(GL_BLEND);
+}
+
+
+// Must be called with the OpenGL context current
+void
+ScoreTicker::cleanup() {
+    delete pVao;
+    pVao = nullptr;
+    delete pAtlas;
+    pAtlas = nullptr;
+    delete pProgram;
+    pProgram = nullptr;
+    vertexBuf.destroy();
+    bAtlasDirty = true;
+    bQuadsDirty = true;
+}
@@ -0,0 +1,78 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLTexture>
+#include <QOpenGLBuffer>
+#include <QOpenGLVertexArrayObject>
+#include <QVector>
+#include <QRectF>
+#include <QString>
+#include <QSize>
+
+
+// The score drawn over the slides and the spots by the GL pass
+// of the Slide Window. Digits, separators and team names are
+// pre-rendered in a glyph atlas: a score update only rewrites the
+// few quads of the vertex buffer.
+class ScoreTicker : protected QOpenGLFunctions
+{
+public:
+    ScoreTicker();
+
+public:
+    bool initialize(const QString& sShaderDir, QSize newPanelSize);
+    void setTeam(int iTeam, const QString& sTeam);
+    void setScore(int iTeam, int iScore);
+    void draw();
+    void cleanup();
+
+private:
+    struct TickerVertex {
+        GLfloat x, y;
+        GLfloat u, v;
+    };
+
+private:
+    void buildAtlas();
+    void buildQuads();
+    void addQuad(QVector<TickerVertex>* pVertices, QRectF screenRect, QRectF atlasRect);
+    void setVertexAttributes();
+
+private:
+    QOpenGLShaderProgram* pProgram;
+    QOpenGLTexture*       pAtlas;
+    QOpenGLVertexArrayObject* pVao;
+    QOpenGLBuffer         vertexBuf;
+    GLint                 iPositionLoc;
+    GLint                 iTexcoordLoc;
+    QSize                 panelSize;
+    QString               sTeam[2];
+    int                   iScore[2];
+    QString               sGlyphs;
+    QVector<QRectF>       glyphRects;
+    QRectF                teamRects[2];
+    QRectF                backgroundRect;
+    int                   iBarHeight;
+    int                   nVertices;
+    bool                  bAtlasDirty;
+    bool                  bQuadsDirty;
+};
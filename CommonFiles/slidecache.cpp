@@ -0,0 +1,279 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "slidecache.h"
+#include "slideprefetcher.h"
+
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <climits>
+
+
+#define SLIDE_CACHE_MAGIC   0x32434c53 // "SLC2": to be changed with the file layout
+#define COMPRESSED_MAGIC    0x315a4c53 // "SLZ1"
+
+
+namespace {
+// The pixels follow the header: the header size
+// keeps the first scan line well aligned
+struct CacheHeader {
+    quint32 magic;
+    quint32 width;
+    quint32 height;
+    quint32 bytesPerLine;
+    quint32 format;
+    quint32 reserved[3];
+};
+
+
+// The compressed blocks follow the header
+struct CompressedHeader {
+    quint32 magic;
+    quint32 width;
+    quint32 height;
+    quint32 format;
+    quint32 dataSize;
+    quint32 reserved[3];
+};
+
+
+// Bytes per pixel of the formats the cache writes (0 for the others):
+// a file in any other format is not trusted.
+int
+cachedBytesPerPixel(quint32 format) {
+    switch(QImage::Format(format)) {
+    case QImage::Format_RGBA8888_Premultiplied:
+        return 4;
+    case QImage::Format_RGB888:
+        return 3;
+    case QImage::Format_RGB16:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+
+void
+unmapSlide(void* pInfo) {
+    QFile* pFile = static_cast<QFile*>(pInfo);
+    delete pFile; // The mapping goes away with the file
+}
+}
+
+
+SlideCache::SlideCache(QObject *parent)
+    : QObject(parent)
+    , iGeneration(0)
+{
+    // Build the cache on all the available cores
+    threadPool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+
+SlideCache::~SlideCache() {
+    stop();
+}
+
+
+void
+SlideCache::stop() {
+    iGeneration.fetchAndAddOrdered(1);
+    threadPool.clear();
+    threadPool.waitForDone();
+}
+
+
+QString
+SlideCache::cacheDir() {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           QString("/slides");
+}
+
+
+// The key changes whenever the slide file or the
+// way it has to be prepared for the panel change.
+// The raw slides are kept in the format of the textures.
+QString
+SlideCache::cacheFileName(const QFileInfo& slide, QSize panelSize, bool bGpuLetterbox,
+                          TextureCompressor::Format compression, QImage::Format imageFormat)
+{
+    QString sKey = QString("%1|%2|%3|%4x%5|%6")
+                       .arg(slide.absoluteFilePath())
+                       .arg(slide.size())
+                       .arg(slide.lastModified().toMSecsSinceEpoch())
+                       .arg(panelSize.width())
+                       .arg(panelSize.height())
+                       .arg(bGpuLetterbox ? "gpu" : "cpu");
+    if(compression != TextureCompressor::NoCompression)
+        sKey += QString("|%1").arg(TextureCompressor::formatName(compression));
+    else
+        sKey += QString("|%1").arg(int(imageFormat));
+    QByteArray hash = QCryptographicHash::hash(sKey.toUtf8(), QCryptographicHash::Sha1);
+    return QString("%1/%2.raw").arg(cacheDir(), QString::fromLatin1(hash.toHex()));
+}
+
+
+// Starts building, in background, the missing cache files and
+// removes the ones no more needed. Only the new or changed
+// slides are processed.
+void
+SlideCache::update(const QFileInfoList& slides, QSize panelSize, bool bGpuLetterbox,
+                   TextureCompressor::Format compression, QImage::Format imageFormat)
+{
+    int iMyGeneration = iGeneration.fetchAndAddOrdered(1) + 1;
+    threadPool.clear(); // Drop the jobs not yet started
+
+    QDir dir(cacheDir());
+    if(!dir.exists())
+        dir.mkpath(".");
+    QSet<QString> neededFiles;
+    for(const QFileInfo& slide : slides) {
+        QString sCacheFile = cacheFileName(slide, panelSize, bGpuLetterbox, compression, imageFormat);
+        neededFiles.insert(QFileInfo(sCacheFile).fileName());
+        if(QFile::exists(sCacheFile))
+            continue;
+        QString sSlide = slide.absoluteFilePath();
+        threadPool.start([this, sSlide, sCacheFile, panelSize, bGpuLetterbox, compression, imageFormat, iMyGeneration]() {
+            if(iGeneration.loadAcquire() != iMyGeneration)
+                return;
+            QImage image = SlidePrefetcher::composeSlide(sSlide, panelSize, bGpuLetterbox);
+            if(iGeneration.loadAcquire() != iMyGeneration)
+                return;
+            if(compression == TextureCompressor::NoCompression) {
+                writeSlide(sCacheFile, SlidePrefetcher::convertSlide(image, imageFormat));
+                return;
+            }
+            writeCompressedSlide(sCacheFile, SlidePrefetcher::compressSlide(image, compression));
+        });
+    }
+    const QStringList cachedFiles = dir.entryList(QStringList() << "*.raw", QDir::Files);
+    for(const QString& sFile : cachedFiles) {
+        if(!neededFiles.contains(sFile))
+            dir.remove(sFile);
+    }
+}
+
+
+bool
+SlideCache::writeSlide(const QString& sCacheFile, const QImage& image) {
+    if(image.isNull() || (cachedBytesPerPixel(quint32(image.format())) == 0))
+        return false;
+    CacheHeader header = {};
+    header.magic        = SLIDE_CACHE_MAGIC;
+    header.width        = quint32(image.width());
+    header.height       = quint32(image.height());
+    header.bytesPerLine = quint32(image.bytesPerLine());
+    header.format       = quint32(image.format());
+    // QSaveFile: a reader never sees a partially written slide
+    QSaveFile file(sCacheFile);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(image.constBits()), image.sizeInBytes());
+    return file.commit();
+}
+
+
+// Returns a QImage using directly the memory mapped file:
+// no decoding and no copy before the texture upload.
+// A null image is returned if the slide is not (yet) cached.
+QImage
+SlideCache::mapSlide(const QString& sCacheFile) {
+    QFile* pFile = new QFile(sCacheFile);
+    if(!pFile->open(QIODevice::ReadOnly) || (pFile->size() < qint64(sizeof(CacheHeader)))) {
+        delete pFile;
+        return QImage();
+    }
+    uchar* pData = pFile->map(0, pFile->size());
+    if(!pData) {
+        delete pFile;
+        return QImage();
+    }
+    CacheHeader header;
+    memcpy(&header, pData, sizeof(header));
+    qint64 imageBytes = qint64(header.bytesPerLine) * header.height;
+    int nBytesPerPixel = cachedBytesPerPixel(header.format);
+    if((header.magic != SLIDE_CACHE_MAGIC) ||
+       (nBytesPerPixel == 0) ||
+       (header.width == 0) || (header.height == 0) ||
+       (header.width > quint32(INT_MAX)) || (header.height > quint32(INT_MAX)) ||
+       (qint64(header.bytesPerLine) < qint64(header.width) * nBytesPerPixel) ||
+       (pFile->size() < qint64(sizeof(header)) + imageBytes))
+    {
+        delete pFile;
+        return QImage();
+    }
+    return QImage(pData + sizeof(header),
+                  int(header.width),
+                  int(header.height),
+                  qsizetype(header.bytesPerLine),
+                  QImage::Format(header.format),
+                  unmapSlide,
+                  pFile);
+}
+
+
+bool
+SlideCache::writeCompressedSlide(const QString& sCacheFile, const CompressedImage& slide) {
+    if(slide.isNull())
+        return false;
+    CompressedHeader header = {};
+    header.magic    = COMPRESSED_MAGIC;
+    header.width    = quint32(slide.size.width());
+    header.height   = quint32(slide.size.height());
+    header.format   = quint32(slide.format);
+    header.dataSize = quint32(slide.blocks.size());
+    QSaveFile file(sCacheFile);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(slide.blocks);
+    return file.commit();
+}
+
+
+// Compressed slides are 4 to 8 times smaller than the raw ones:
+// they are simply read. A null slide is returned if not (yet) cached.
+CompressedImage
+SlideCache::readCompressedSlide(const QString& sCacheFile) {
+    QFile file(sCacheFile);
+    if(!file.open(QIODevice::ReadOnly))
+        return CompressedImage();
+    CompressedHeader header;
+    if(file.read(reinterpret_cast<char*>(&header), sizeof(header)) != qint64(sizeof(header)))
+        return CompressedImage();
+    QSize size(int(header.width), int(header.height));
+    if((header.magic != COMPRESSED_MAGIC) ||
+       (int(header.dataSize) != TextureCompressor::compressedSize(size)))
+    {
+        return CompressedImage();
+    }
+    CompressedImage slide;
+    slide.size   = size;
+    slide.format = TextureCompressor::Format(header.format);
+    slide.blocks = file.read(header.dataSize);
+    if(slide.blocks.size() != int(header.dataSize))
+        return CompressedImage();
+    return slide;
+}
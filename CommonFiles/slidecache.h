@@ -0,0 +1,62 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QFileInfoList>
+#include <QImage>
+#include <QSize>
+
+#include "texturecompressor.h"
+
+
+// Keeps on disk a copy of every slide already prepared for the panel
+// (scaled, mirrored and composed) in the raw QImage format, so that
+// it can be memory mapped and uploaded without decoding, or already
+// block compressed for the GPU.
+class SlideCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SlideCache(QObject *parent = nullptr);
+    ~SlideCache();
+
+public:
+    void update(const QFileInfoList& slides, QSize panelSize, bool bGpuLetterbox,
+                TextureCompressor::Format compression = TextureCompressor::NoCompression,
+                QImage::Format imageFormat = QImage::Format_RGBA8888_Premultiplied);
+    void stop();
+    static QString cacheFileName(const QFileInfo& slide, QSize panelSize, bool bGpuLetterbox,
+                                 TextureCompressor::Format compression = TextureCompressor::NoCompression,
+                                 QImage::Format imageFormat = QImage::Format_RGBA8888_Premultiplied);
+    static QImage mapSlide(const QString& sCacheFile);
+    static CompressedImage readCompressedSlide(const QString& sCacheFile);
+
+private:
+    static QString cacheDir();
+    static bool writeSlide(const QString& sCacheFile, const QImage& image);
+    static bool writeCompressedSlide(const QString& sCacheFile, const CompressedImage& slide);
+
+private:
+    QThreadPool threadPool;
+    QAtomicInt  iGeneration;
+};
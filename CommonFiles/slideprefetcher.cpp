@@ -0,0 +1,375 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "slideprefetcher.h"
+#include "slidecache.h"
+
+#include <QPainter>
+#include <QImageReader>
+#include <QMutexLocker>
+#include <QDeadlineTimer>
+
+
+#define PREFETCH_DEPTH  3 // Default max number of slides composed ahead of time
+
+
+SlidePrefetcher::SlidePrefetcher(QObject *parent)
+    : QThread(parent)
+    , iNextSlide(0)
+    , iPendingSlide(0)
+    , iGeneration(0)
+    , iQueueDepth(PREFETCH_DEPTH)
+    , imageFormat(QImage::Format_RGBA8888_Premultiplied)
+    , compression(TextureCompressor::NoCompression)
+    , bGpuLetterbox(false)
+    , bSlideCache(false)
+    , bAbort(false)
+{
+}
+
+
+SlidePrefetcher::~SlidePrefetcher() {
+    stopPrefetch();
+    wait();
+}
+
+
+void
+SlidePrefetcher::stopPrefetch() {
+    QMutexLocker locker(&mutex);
+    bAbort = true;
+    queueNotFull.wakeAll();
+    queueNotEmpty.wakeAll();
+}
+
+
+// Called with the mutex locked.
+// Slides already composed (or being composed) are thrown away
+// and the worker starts again from the first one not yet taken.
+void
+SlidePrefetcher::discardQueue() {
+    readyQueue.clear();
+    iGeneration++;
+    iNextSlide = iPendingSlide;
+    queueNotFull.wakeAll();
+}
+
+
+void
+SlidePrefetcher::setPanelSize(QSize newSize) {
+    QMutexLocker locker(&mutex);
+    if(newSize == panelSize)
+        return;
+    panelSize = newSize;
+    discardQueue();
+}
+
+
+void
+SlidePrefetcher::setGpuLetterbox(bool bEnable) {
+    QMutexLocker locker(&mutex);
+    if(bEnable == bGpuLetterbox)
+        return;
+    bGpuLetterbox = bEnable;
+    discardQueue();
+}
+
+
+void
+SlidePrefetcher::setSlideCache(bool bEnable) {
+    QMutexLocker locker(&mutex);
+    bSlideCache = bEnable;
+}
+
+
+// The slides are queued already in the format of the textures:
+// with the formats without alpha they take less memory.
+void
+SlidePrefetcher::setImageFormat(QImage::Format newFormat) {
+    QMutexLocker locker(&mutex);
+    if(newFormat == imageFormat)
+        return;
+    imageFormat = newFormat;
+    discardQueue();
+}
+
+
+// The slides beyond the new depth are dropped and composed again
+// when their turn comes: the one being composed is dropped as well
+// or it would be queued before them.
+void
+SlidePrefetcher::setQueueDepth(int newDepth) {
+    QMutexLocker locker(&mutex);
+    iQueueDepth = qMax(newDepth, 1);
+    if(readyQueue.count() > iQueueDepth) {
+        iNextSlide = readyQueue.at(iQueueDepth).iSlide;
+        while(readyQueue.count() > iQueueDepth)
+            readyQueue.removeLast();
+        iGeneration++;
+    }
+    queueNotFull.wakeAll();
+}
+
+
+// With a compression format the worker delivers the slides
+// already block compressed: the CPU work is all done here.
+void
+SlidePrefetcher::setCompression(TextureCompressor::Format newCompression) {
+    QMutexLocker locker(&mutex);
+    if(newCompression == compression)
+        return;
+    compression = newCompression;
+    discardQueue();
+}
+
+
+// Memory taken by the slides waiting in the queue
+qint64
+SlidePrefetcher::queuedBytes() {
+    QMutexLocker locker(&mutex);
+    qint64 nBytes = 0;
+    for(const ReadySlide& slide : std::as_const(readyQueue))
+        nBytes += slide.image.sizeInBytes() + slide.compressed.blocks.size();
+    return nBytes;
+}
+
+
+void
+SlidePrefetcher::setSlideList(const QFileInfoList& newList, int iFirstSlide) {
+    QMutexLocker locker(&mutex);
+    slideList     = newList;
+    iPendingSlide = slideList.isEmpty() ? 0 : iFirstSlide % slideList.count();
+    discardQueue();
+}
+
+
+// Called with the mutex locked.
+// Position in newList of the slide at iSlide in the current list
+int
+SlidePrefetcher::remapSlide(const QFileInfoList& newList, int iSlide) const {
+    if(slideList.isEmpty() || newList.isEmpty())
+        return 0;
+    QString sFile = slideList.at(iSlide).absoluteFilePath();
+    for(int i=0; i<newList.count(); i++) {
+        if(newList.at(i).absoluteFilePath() == sFile)
+            return i;
+    }
+    return iSlide % newList.count();
+}
+
+
+// The slides already composed are kept and the worker goes on
+// from the same file, if still there.
+void
+SlidePrefetcher::updateSlideList(const QFileInfoList& newList) {
+    QMutexLocker locker(&mutex);
+    iNextSlide    = remapSlide(newList, iNextSlide);
+    iPendingSlide = remapSlide(newList, iPendingSlide);
+    for(ReadySlide& slide : readyQueue)
+        slide.iSlide = remapSlide(newList, slide.iSlide);
+    slideList = newList;
+    queueNotFull.wakeAll();
+}
+
+
+// Returns the oldest composed slide waiting at most msTimeout
+// for the worker. On timeout the caller has to do the work by itself.
+// With the compression the slide is returned in pCompressed.
+bool
+SlidePrefetcher::takeSlide(QImage* pImage, int msTimeout, CompressedImage* pCompressed) {
+    QMutexLocker locker(&mutex);
+    QDeadlineTimer deadline(msTimeout);
+    while(readyQueue.isEmpty() && !bAbort && !slideList.isEmpty()) {
+        if(!queueNotEmpty.wait(&mutex, deadline))
+            break;
+    }
+    if(readyQueue.isEmpty())
+        return false;
+    ReadySlide slide = readyQueue.dequeue();
+    if(!slideList.isEmpty())
+        iPendingSlide = (slide.iSlide + 1) % slideList.count();
+    *pImage = slide.image;
+    if(pCompressed)
+        *pCompressed = slide.compressed;
+    queueNotFull.wakeAll();
+    return true;
+}
+
+
+// The image plugin is asked up front for a size not bigger than
+// needed: big JPEGs are then decoded with the 1/2, 1/4 or 1/8
+// scaled IDCT instead of decoding at full resolution and shrinking.
+QImage
+SlidePrefetcher::decodeSlide(const QString& sFileName, QSize maxSize) {
+    QImageReader reader(sFileName);
+    QSize imageSize = reader.size();
+    if(imageSize.isValid() &&
+       ((imageSize.width() > maxSize.width()) || (imageSize.height() > maxSize.height())))
+    {
+        reader.setScaledSize(imageSize.scaled(maxSize, Qt::KeepAspectRatio));
+    }
+    QImage image;
+    if(!reader.read(&image))
+        return QImage();
+    return image;
+}
+
+
+QImage
+SlidePrefetcher::composeSlide(const QString& sFileName, QSize size, bool bGpuLetterbox) {
+    return composeImage(decodeSlide(sFileName, size), size, bGpuLetterbox);
+}
+
+
+// The image is scaled to fit the panel, mirrored (OpenGL textures
+// are bottom-up) and centered over a white background.
+// With bGpuLetterbox all this is left to the transition shaders and
+// the image is only shrunk if it does not fit the panel.
+QImage
+SlidePrefetcher::composeImage(const QImage& srcImage, QSize size, bool bGpuLetterbox) {
+    QImage newImage = srcImage;
+    if(bGpuLetterbox) {
+        if(newImage.isNull()) {
+            newImage = QImage(1, 1, QImage::Format_RGBA8888_Premultiplied);
+            newImage.fill(Qt::white);
+        }
+        if((newImage.width() > size.width()) || (newImage.height() > size.height()))
+            newImage = newImage.scaled(size, Qt::KeepAspectRatio);
+        return newImage.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+    }
+    QImage baseImage(size, QImage::Format_RGBA8888_Premultiplied);
+    QImage image = newImage.scaled(size, Qt::KeepAspectRatio).mirrored();
+    QPainter painter(&baseImage);
+    painter.fillRect(baseImage.rect(), Qt::white);
+    int x = (baseImage.width()  - image.width())  / 2;
+    int y = (baseImage.height() - image.height()) / 2;
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter.drawImage(x, y, image);
+    painter.end();
+    return baseImage;
+}
+
+
+// The memory mapped copy from the SlideCache, when already built,
+// saves the decoding, the composition and the conversion of the slide.
+QImage
+SlidePrefetcher::loadSlide(const QFileInfo& slide, QSize size, bool bGpuLetterbox,
+                           QImage::Format format, bool bUseCache)
+{
+    if(bUseCache) {
+        QString sCacheFile = SlideCache::cacheFileName(slide, size, bGpuLetterbox,
+                                                       TextureCompressor::NoCompression, format);
+        QImage image = SlideCache::mapSlide(sCacheFile);
+        if(!image.isNull())
+            return convertSlide(image, format); // Already there: no copy
+    }
+    return convertSlide(composeSlide(slide.absoluteFilePath(), size, bGpuLetterbox), format);
+}
+
+
+// The slide is flattened over white before being compressed:
+// the compressed formats have no alpha
+CompressedImage
+SlidePrefetcher::compressSlide(const QImage& slide, TextureCompressor::Format compression) {
+    CompressedImage compressed;
+    if(slide.isNull())
+        return compressed;
+    compressed.size   = slide.size();
+    compressed.format = compression;
+    compressed.blocks = TextureCompressor::compress(convertSlide(slide, QImage::Format_RGBX8888),
+                                                    compression);
+    return compressed;
+}
+
+
+CompressedImage
+SlidePrefetcher::loadCompressedSlide(const QFileInfo& slide, QSize size, bool bGpuLetterbox,
+                                     bool bUseCache, TextureCompressor::Format compression)
+{
+    if(bUseCache) {
+        CompressedImage compressed =
+            SlideCache::readCompressedSlide(SlideCache::cacheFileName(slide, size, bGpuLetterbox, compression));
+        if(!compressed.isNull())
+            return compressed;
+    }
+    return compressSlide(composeSlide(slide.absoluteFilePath(), size, bGpuLetterbox), compression);
+}
+
+
+// Formats without alpha: the transparent parts
+// of the slide are shown over the white background.
+QImage
+SlidePrefetcher::convertSlide(const QImage& slide, QImage::Format format) {
+    if(slide.format() == format)
+        return slide;
+    if(slide.hasAlphaChannel() &&
+       (QImage::toPixelFormat(format).alphaUsage() == QPixelFormat::IgnoresAlpha))
+    {
+        QImage flatImage(slide.size(), format);
+        flatImage.fill(Qt::white);
+        QPainter painter(&flatImage);
+        painter.drawImage(0, 0, slide);
+        painter.end();
+        return flatImage;
+    }
+    return slide.convertToFormat(format);
+}
+
+
+void
+SlidePrefetcher::run() {
+    forever {
+        mutex.lock();
+        while(!bAbort &&
+              (slideList.isEmpty() ||
+               panelSize.isEmpty() ||
+               (readyQueue.count() >= iQueueDepth)))
+        {
+            queueNotFull.wait(&mutex);
+        }
+        if(bAbort) {
+            mutex.unlock();
+            return;
+        }
+        QFileInfo slide = slideList.at(iNextSlide);
+        QSize size = panelSize;
+        bool bLetterbox = bGpuLetterbox;
+        bool bUseCache = bSlideCache;
+        QImage::Format format = imageFormat;
+        TextureCompressor::Format slideCompression = compression;
+        int iMyGeneration = iGeneration;
+        int iSlide = iNextSlide;
+        iNextSlide = (iNextSlide + 1) % slideList.count();
+        mutex.unlock();
+
+        ReadySlide newSlide;
+        newSlide.iSlide = iSlide;
+        if(slideCompression == TextureCompressor::NoCompression)
+            newSlide.image = loadSlide(slide, size, bLetterbox, format, bUseCache);
+        else
+            newSlide.compressed = loadCompressedSlide(slide, size, bLetterbox, bUseCache, slideCompression);
+
+        mutex.lock();
+        // Drop the slide if the list or the panel changed meanwhile
+        if(iMyGeneration == iGeneration) {
+            readyQueue.enqueue(newSlide);
+            queueNotEmpty.wakeAll();
+        }
+        mutex.unlock();
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QImage>
+#include <QFileInfoList>
+#include <QSize>
+
+#include "texturecompressor.h"
+
+
+// Decodes and composes the next slides in a worker thread so that
+// SlideWidget only has to upload an already prepared image.
+class SlidePrefetcher : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit SlidePrefetcher(QObject *parent = nullptr);
+    ~SlidePrefetcher();
+
+public:
+    void setPanelSize(QSize newSize);
+    void setGpuLetterbox(bool bEnable);
+    void setSlideCache(bool bEnable);
+    void setImageFormat(QImage::Format newFormat);
+    void setQueueDepth(int newDepth);
+    void setCompression(TextureCompressor::Format newCompression);
+    qint64 queuedBytes();
+    void setSlideList(const QFileInfoList& newList, int iFirstSlide);
+    void updateSlideList(const QFileInfoList& newList);
+    bool takeSlide(QImage* pImage, int msTimeout, CompressedImage* pCompressed = nullptr);
+    void stopPrefetch();
+    static QImage decodeSlide(const QString& sFileName, QSize maxSize);
+    static QImage composeSlide(const QString& sFileName, QSize size, bool bGpuLetterbox);
+    static QImage composeImage(const QImage& newImage, QSize size, bool bGpuLetterbox);
+    static QImage convertSlide(const QImage& slide, QImage::Format format);
+    static QImage loadSlide(const QFileInfo& slide, QSize size, bool bGpuLetterbox,
+                            QImage::Format format, bool bUseCache);
+    static CompressedImage compressSlide(const QImage& slide, TextureCompressor::Format compression);
+    static CompressedImage loadCompressedSlide(const QFileInfo& slide, QSize size, bool bGpuLetterbox,
+                                               bool bUseCache, TextureCompressor::Format compression);
+
+protected:
+    void run() override;
+
+private:
+    // Either the image or, with the compression, the blocks
+    struct ReadySlide {
+        QImage          image;
+        CompressedImage compressed;
+        int             iSlide = 0; // Position in the slide list
+    };
+
+private:
+    void discardQueue();
+    int  remapSlide(const QFileInfoList& newList, int iSlide) const;
+
+private:
+    QMutex         mutex;
+    QWaitCondition queueNotFull;
+    QWaitCondition queueNotEmpty;
+    QQueue<ReadySlide> readyQueue;
+    QFileInfoList  slideList;
+    QSize          panelSize;
+    int            iNextSlide;
+    int            iPendingSlide;
+    int            iGeneration;
+    int            iQueueDepth;
+    QImage::Format imageFormat;
+    TextureCompressor::Format compression;
+    bool           bGpuLetterbox;
+    bool           bSlideCache;
+    bool           bAbort;
+};
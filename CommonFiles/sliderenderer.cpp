@@ -0,0 +1,361 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "sliderenderer.h"
+#include "slideprefetcher.h"
+#include "utility.h"
+
+#include <QWindow>
+#include <QOpenGLContext>
+
+
+#define STEADY_SHOW_TIME       3000 // Change slide time
+#define TRANSITION_TIME        1500 // Default transition duration
+#define PREFETCH_TIMEOUT       2000 // Max wait for the prefetched slide
+#define PREFETCH_RETRY_TIME     250 // Next request of a slide not ready in time
+#define TEXTURE_POOL_SIZE         2 // Slide textures ping-ponged by the transitions
+
+
+SlideRenderer::SlideRenderer(QFile* myLogFile, SlidePrefetcher* pSlidePrefetcher)
+    : QObject()
+    , pLogFile(myLogFile)
+    , pPrefetcher(pSlidePrefetcher)
+    , pWindow(nullptr)
+    , pContext(nullptr)
+    , pTimerSteady(nullptr)
+    , pTexture0(nullptr)
+    , pTexture1(nullptr)
+    , msRefresh(1000.0/60.0)
+    , progress(0.0f)
+    , msTransitionTime(TRANSITION_TIME)
+    , nTransitionFrames(0)
+    , nDroppedFrames(0)
+    , bGpuLetterbox(false)
+    , bAnimating(false)
+    , bRunning(false)
+    , bFrameQueued(false)
+    , bNextSlideReady(false)
+    , slideTransitions(myLogFile)
+{
+}
+
+
+SlideRenderer::~SlideRenderer() {
+    delete pContext;
+}
+
+
+// Creates, in the render thread, the context used
+// to draw on the window surface.
+void
+SlideRenderer::initialize(QWindow* pSurfaceWindow, double refreshRate, QSize newPanelSize) {
+    pWindow = pSurfaceWindow;
+    panelSize = newPanelSize;
+    if(refreshRate <= 0.0) refreshRate = 60.0;
+    msRefresh = 1000.0 / refreshRate;
+
+    pTimerSteady = new QTimer(this); // In the render thread
+    pTimerSteady->setSingleShot(true);
+    connect(pTimerSteady, SIGNAL(timeout()),
+            this, SLOT(onTimerSteadyEvent()));
+
+    pContext = new QOpenGLContext();
+    pContext->setFormat(pWindow->requestedFormat());
+    if(!pContext->create() || !pContext->makeCurrent(pWindow)) {
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to create the render thread OpenGL context"));
+        delete pContext;
+        pContext = nullptr;
+        return;
+    }
+    initializeOpenGLFunctions();
+    glEnable(GL_CULL_FACE);
+    slideTransitions.initialize(panelSize, refreshRate);
+    initTextures();
+}
+
+
+void
+SlideRenderer::setViewportSize(QSize newSize) {
+    viewportSize = newSize;
+    requestFrame();
+}
+
+
+void
+SlideRenderer::setGpuLetterbox(bool bEnable) {
+    if(bEnable == bGpuLetterbox)
+        return;
+    bGpuLetterbox = bEnable;
+    // The programs are rebuilt at the next frame
+    slideTransitions.setGpuLetterbox(bEnable);
+}
+
+
+void
+SlideRenderer::setTransitionDuration(int msDuration) {
+    msTransitionTime = qMax(msDuration, 1);
+}
+
+
+void
+SlideRenderer::initTextures() {
+    for(int i=0; i<TEXTURE_POOL_SIZE; i++) {
+        QOpenGLTexture* pTexture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+        pTexture->setFormat(QOpenGLTexture::RGBA8_UNorm);
+        pTexture->setSize(panelSize.width(), panelSize.height());
+        pTexture->setMipLevels(1);
+        pTexture->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+        pTexture->setMinificationFilter(QOpenGLTexture::Nearest);
+        pTexture->setMagnificationFilter(QOpenGLTexture::Linear);
+        pTexture->setWrapMode(QOpenGLTexture::Repeat);
+        texturePool.append(pTexture);
+    }
+}
+
+
+// Returns a pool texture not in use by the current transition
+QOpenGLTexture*
+SlideRenderer::freeTexture() {
+    for(int i=0; i<texturePool.count(); i++) {
+        QOpenGLTexture* pTexture = texturePool.at(i);
+        if((pTexture != pTexture0) && (pTexture != pTexture1))
+            return pTexture;
+    }
+    return nullptr;
+}
+
+
+// Must be called with the context current
+void
+SlideRenderer::uploadSlide(QOpenGLTexture* pTexture, const QImage& slide) {
+    QImage glImage = slide;
+    QSize textureSize(pTexture->width(), pTexture->height());
+    if(bGpuLetterbox) {
+        if((glImage.width() > textureSize.width()) || (glImage.height() > textureSize.height()))
+            glImage = glImage.scaled(textureSize, Qt::KeepAspectRatio);
+    }
+    else if(glImage.size() != textureSize)
+        glImage = glImage.scaled(textureSize);
+    if(glImage.format() != QImage::Format_RGBA8888_Premultiplied)
+        glImage = SlidePrefetcher::convertSlide(glImage, QImage::Format_RGBA8888_Premultiplied);
+    pTexture->bind();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                    glImage.width(), glImage.height(),
+                    GL_RGBA, GL_UNSIGNED_BYTE,
+                    glImage.constBits());
+    pTexture->release();
+    slideTransitions.placeSlide(pTexture, glImage.size());
+}
+
+
+// The image on the screen when the show starts (the score panel)
+void
+SlideRenderer::showImage(const QImage& image) {
+    if(!pContext || !pContext->makeCurrent(pWindow))
+        return;
+    pTexture0 = nullptr;
+    pTexture0 = freeTexture();
+    if(pTexture0)
+        uploadSlide(pTexture0, image);
+    requestFrame();
+}
+
+
+void
+SlideRenderer::startShow() {
+    if(!pContext || !pTexture0)
+        return;
+    bRunning = true;
+    prepareNextRound();
+    pTimerSteady->stop();
+    startTransition();
+}
+
+
+void
+SlideRenderer::stopShow() {
+    if(pTimerSteady)
+        pTimerSteady->stop();
+    bAnimating = false;
+    bRunning = false;
+    bNextSlideReady = false;
+    pTexture0 = nullptr;
+    pTexture1 = nullptr;
+#ifdef LOG_MESG
+    const QStringList lines = frameStats.report();
+    for(const QString& sLine : lines)
+        logMessage(pLogFile, Q_FUNC_INFO, sLine);
+    slideTransitions.logState();
+#endif
+}
+
+
+// Takes the next slide from the prefetcher and puts it in the
+// texture not on the screen. Waiting for it blocks only this thread.
+// If it is not ready it is asked again by startTransition().
+bool
+SlideRenderer::prepareNextRound() {
+    bNextSlideReady = false;
+    if(!pContext->makeCurrent(pWindow))
+        return false;
+    QOpenGLTexture* pFreeTexture = (pTexture1 && (pTexture1 != pTexture0)) ? pTexture1 : freeTexture();
+    if(!pFreeTexture)
+        return false;
+    QImage nextSlide;
+    if(!pPrefetcher->takeSlide(&nextSlide, PREFETCH_TIMEOUT)) {
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Next slide not ready"));
+        return false;
+    }
+    pTexture1 = pFreeTexture;
+    uploadSlide(pTexture1, nextSlide);
+    bNextSlideReady = true;
+    return true;
+}
+
+
+void
+SlideRenderer::startTransition() {
+    if(!bNextSlideReady && !prepareNextRound()) {
+        pTimerSteady->start(PREFETCH_RETRY_TIME);
+        return;
+    }
+    if(!pContext->makeCurrent(pWindow))
+        return;
+    QOpenGLShaderProgram* pProgram = slideTransitions.currentProgram();
+    if(!pProgram || !pTexture0) { // No shader built
+        pTimerSteady->start(STEADY_SHOW_TIME); // Try again later
+        return;
+    }
+    frameStats.addRun(pProgram->objectName());
+    progress          = 0.0f;
+    nTransitionFrames = 0;
+    nDroppedFrames    = 0;
+    bAnimating        = true;
+    transitionTime.start();
+    lastSwapTime.start();
+    requestFrame();
+}
+
+
+void
+SlideRenderer::onTimerSteadyEvent() {
+    if(bRunning)
+        startTransition();
+}
+
+
+// Frames are queued one at a time so that the other
+// requests of the GUI thread are served between them.
+void
+SlideRenderer::requestFrame() {
+    if(bFrameQueued)
+        return;
+    bFrameQueued = true;
+    QMetaObject::invokeMethod(this, "renderFrame", Qt::QueuedConnection);
+}
+
+
+void
+SlideRenderer::drawFrame() {
+    glViewport(0, 0, viewportSize.width(), viewportSize.height());
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if(!pTexture0)
+        return;
+    // Without a next slide, texture0 alone is shown
+    slideTransitions.draw(pTexture0, pTexture1 ? pTexture1 : pTexture0, progress);
+}
+
+
+// Draws a frame and swaps: with the swap interval of the default
+// format the swap waits for the vertical refresh, pacing the loop.
+void
+SlideRenderer::renderFrame() {
+    bFrameQueued = false;
+    if(!pContext || !pWindow->isExposed())
+        return;
+    if(!pContext->makeCurrent(pWindow))
+        return;
+    if(bAnimating)
+        progress = qMin(GLfloat(transitionTime.elapsed()) / GLfloat(msTransitionTime), 1.0f);
+    QElapsedTimer cpuTime;
+    cpuTime.start();
+    drawFrame();
+    QString sTransition = slideTransitions.currentName();
+    if(bAnimating)
+        frameStats.addCpuTime(sTransition, double(cpuTime.nsecsElapsed())/1.0e6);
+    pContext->swapBuffers(pWindow);
+    if(!bAnimating)
+        return;
+
+    double msFrame = double(lastSwapTime.nsecsElapsed())/1.0e6;
+    lastSwapTime.start();
+    if(nTransitionFrames > 0) {
+        int nMissed = qMax(qRound(msFrame/msRefresh) - 1, 0);
+        nDroppedFrames += nMissed;
+        frameStats.addSwap(sTransition, msFrame, nMissed);
+    }
+    nTransitionFrames++;
+    if(progress < 1.0f) {
+        requestFrame();
+        return;
+    }
+    // Transition done: the target slide is now the one on the screen
+    bAnimating = false;
+    slideTransitions.transitionDone(nTransitionFrames,
+                                    nDroppedFrames,
+                                    double(transitionTime.elapsed()));
+    QOpenGLTexture* pShown = pTexture1;
+    pTexture1 = pTexture0;
+    pTexture0 = pShown;
+    progress = 0.0f;
+    slideTransitions.nextTransition();
+    prepareNextRound(); // If not yet ready it is retried by startTransition()
+    requestFrame();
+    pTimerSteady->start(STEADY_SHOW_TIME);
+}
+
+
+void
+SlideRenderer::cleanOpenGL() {
+    for(int i=0; i<texturePool.count(); i++)
+        delete texturePool.at(i);
+    texturePool.clear();
+    pTexture0 = nullptr;
+    pTexture1 = nullptr;
+    slideTransitions.cleanup();
+}
+
+
+// Called (blocking) before the render thread quits
+void
+SlideRenderer::shutdown() {
+    if(pTimerSteady)
+        pTimerSteady->stop();
+    bAnimating = false;
+    if(pContext && pContext->makeCurrent(pWindow)) {
+        cleanOpenGL();
+        pContext->doneCurrent();
+    }
+    delete pContext;
+    pContext = nullptr;
+}
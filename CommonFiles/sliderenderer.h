@@ -0,0 +1,99 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QOpenGLFunctions>
+#include <QOpenGLTexture>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QFile>
+
+#include "transitionstats.h"
+#include "slidetransitions.h"
+
+
+QT_FORWARD_DECLARE_CLASS(QWindow)
+QT_FORWARD_DECLARE_CLASS(QOpenGLContext)
+QT_FORWARD_DECLARE_CLASS(SlidePrefetcher)
+
+
+// The Slide Show of SlideWindow. Lives in its own thread with its own
+// OpenGL context: the frames are paced by the buffer swaps of this
+// thread and never wait for the GUI event loop (nor block it).
+// Every slot has to be invoked with a queued connection.
+class SlideRenderer : public QObject, protected QOpenGLFunctions
+{
+    Q_OBJECT
+
+public:
+    SlideRenderer(QFile* myLogFile, SlidePrefetcher* pSlidePrefetcher);
+    ~SlideRenderer();
+
+public slots:
+    void initialize(QWindow* pSurfaceWindow, double refreshRate, QSize newPanelSize);
+    void setViewportSize(QSize newSize);
+    void setGpuLetterbox(bool bEnable);
+    void setTransitionDuration(int msDuration);
+    void showImage(const QImage& image);
+    void startShow();
+    void stopShow();
+    void requestFrame();
+    void shutdown();
+
+private slots:
+    void renderFrame();
+    void onTimerSteadyEvent();
+
+private:
+    void initTextures();
+    QOpenGLTexture* freeTexture();
+    void uploadSlide(QOpenGLTexture* pTexture, const QImage& slide);
+    void drawFrame();
+    void startTransition();
+    bool prepareNextRound();
+    void cleanOpenGL();
+
+private:
+    QFile*            pLogFile;
+    SlidePrefetcher*  pPrefetcher;
+    QWindow*          pWindow;
+    QOpenGLContext*   pContext;
+    QTimer*           pTimerSteady;
+    QElapsedTimer     transitionTime;
+    QElapsedTimer     lastSwapTime;
+    QOpenGLTexture*   pTexture0;
+    QOpenGLTexture*   pTexture1;
+    QVector<QOpenGLTexture*> texturePool;
+    QSize             panelSize;
+    QSize             viewportSize;
+    double            msRefresh;
+    GLfloat           progress;
+    int               msTransitionTime;
+    int               nTransitionFrames;
+    int               nDroppedFrames;
+    bool              bGpuLetterbox;
+    bool              bAnimating;
+    bool              bRunning;
+    bool              bFrameQueued;
+    bool              bNextSlideReady;
+    TransitionStats   frameStats;
+    SlideTransitions  slideTransitions;
+};
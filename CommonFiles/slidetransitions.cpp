@@ -0,0 +1,394 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "slidetransitions.h"
+#include "utility.h"
+
+#include <QDebug>
+
+
+SlideTransitions::SlideTransitions(QFile* myLogFile)
+    : pLogFile(myLogFile)
+    , iCurrent(-1)
+    , arrayBuf(QOpenGLBuffer::VertexBuffer)
+    , indexBuf(QOpenGLBuffer::IndexBuffer)
+    , pPlacedTexture0(nullptr)
+    , pPlacedTexture1(nullptr)
+    , iPlacedTransition(-1)
+    , borderColor(Qt::white)
+    , bGpuLetterbox(false)
+    , bStalePrograms(false)
+    , bPlacementChanged(true)
+    , governor(myLogFile)
+{
+    m.ortho(-1.0f, +1.0f, -1.0f, 1.0f, 4.0f, 15.0f);
+    m.translate(0.0f, 0.0f, -10.0);
+}
+
+
+// Only the first transition is built here: the others are
+// built on first use or when idle (see prewarm()).
+void
+SlideTransitions::initialize(QSize newPanelSize, double refreshRate) {
+    initializeOpenGLFunctions();
+    panelSize = newPanelSize;
+    governor.setRefreshRate(refreshRate);
+    glClearColor(borderColor.redF(), borderColor.greenF(), borderColor.blueF(), 1);
+    initGeometry();
+    initShaders();
+    nextTransition();
+}
+
+
+// The transition shaders depend on the letterbox mode: the programs
+// already built are dropped and built again on their next use.
+void
+SlideTransitions::setGpuLetterbox(bool bEnable) {
+    if(bEnable == bGpuLetterbox)
+        return;
+    bGpuLetterbox = bEnable;
+    bStalePrograms = !transitions.isEmpty();
+}
+
+
+QString
+SlideTransitions::shaderDir() const {
+    return sShaderDir;
+}
+
+
+// The meshes of all the transitions (see transitionMeshes())
+// in a single vertex and a single index buffer.
+void
+SlideTransitions::initGeometry() {
+    QVector<TransitionVertex> vertices;
+    QVector<quint16>          indices;
+    transitionMeshes(&vertices, &indices, meshRanges);
+
+    // Transfer vertex data to VBO
+    arrayBuf.create();
+    arrayBuf.bind();
+    arrayBuf.allocate(vertices.data(), int(vertices.count()*sizeof(TransitionVertex)));
+    // and the indices to the IBO
+    indexBuf.create();
+    indexBuf.bind();
+    indexBuf.allocate(indices.data(), int(indices.count()*sizeof(quint16)));
+}
+
+
+void
+SlideTransitions::initShaders() {
+#ifdef __ARM_ARCH
+    #ifdef RPI3
+    sShaderDir = "/CommonFiles/ShadersRPi3";
+    #else
+    sShaderDir = "/CommonFiles/ShadersRPi4";
+    #endif
+#else
+    sShaderDir = "/CommonFiles/Shaders";
+#endif
+    // Not every transition has been ported to every platform: what
+    // runs well is then decided at runtime by the governor
+    transitionTable.clear();
+    QStringList transitionNames;
+    const QList<TransitionEntry> allTransitions = transitionList();
+    for(const TransitionEntry& entry : allTransitions) {
+        if(QFile::exists(QString(":%1/%2.glsl").arg(sShaderDir, entry.sShader))) {
+            transitionTable.append(entry);
+            transitionNames.append(entry.sShader);
+        }
+    }
+    transitions.fill(Transition(), transitionTable.count());
+    governor.setTransitions(transitionNames);
+}
+
+
+// Returns the program of the transition building it if still needed.
+// Every program gets its own baked descriptor (see bakeTransition()).
+// The shaders are "cacheable": Qt stores the linked program binary on
+// disk, keyed by the shader sources and the OpenGL vendor, renderer and
+// version, so after the first run the link is just a binary load.
+// A transition whose shaders do not build is disabled in the governor.
+QOpenGLShaderProgram*
+SlideTransitions::transitionProgram(int iTransition) {
+    if((iTransition < 0) || (iTransition >= transitions.count()))
+        return nullptr;
+    if(transitions.at(iTransition).pProgram)
+        return transitions.at(iTransition).pProgram;
+    if(!governor.isUsable(iTransition)) // Already failed
+        return nullptr;
+
+    QOpenGLShaderProgram* pNewProgram = new QOpenGLShaderProgram();
+    QString sFshader = QString(":%1/%2.glsl").arg(sShaderDir, transitionTable.at(iTransition).sShader);
+    pNewProgram->setObjectName(transitionTable.at(iTransition).sShader);
+    Transition newTransition;
+    newTransition.pProgram = pNewProgram;
+    newTransition.mesh     = transitionTable.at(iTransition).mesh;
+    if(!pNewProgram->addCacheableShaderFromSourceFile(QOpenGLShader::Vertex, QString(":%1/vShader.glsl").arg(sShaderDir)) ||
+       !pNewProgram->addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, transitionSource(sFshader, bGpuLetterbox)) ||
+       !pNewProgram->link() ||
+       !bakeTransition(&newTransition))
+    {
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to build %1: transition disabled").arg(sFshader));
+        governor.disableTransition(iTransition);
+        delete newTransition.pVao;
+        delete pNewProgram;
+        return nullptr;
+    }
+    transitions[iTransition] = newTransition;
+    return pNewProgram;
+}
+
+
+// Everything the transition needs that does not change frame by frame
+// is prepared here, just once, after the link: attribute and uniform
+// locations, the constant uniforms and a Vertex Array Object.
+bool
+SlideTransitions::bakeTransition(Transition* pTransition) {
+    QOpenGLShaderProgram* pProgram = pTransition->pProgram;
+    pTransition->iPositionLoc = pProgram->attributeLocation("a_position");
+    pTransition->iTexcoordLoc = pProgram->attributeLocation("a_texcoord");
+    if((pTransition->iPositionLoc == -1) || (pTransition->iTexcoordLoc == -1)) {
+        qCritical() << "Shader attributes not found";
+        return false;
+    }
+    // The placement uniforms are there only with the GPU letterbox
+    pTransition->iProgressLoc  = pProgram->uniformLocation("progress");
+    pTransition->iTexRect0Loc  = pProgram->uniformLocation("texRect0");
+    pTransition->iTexRect1Loc  = pProgram->uniformLocation("texRect1");
+    pTransition->iTexExtentLoc = pProgram->uniformLocation("texExtent");
+    if(pTransition->iProgressLoc == -1) {
+        qCritical() << __FUNCTION__ << __LINE__ << "Shader uniform not found";
+        return false;
+    }
+
+    pProgram->bind();
+    pProgram->setUniformValue("texture0", 0);
+    pProgram->setUniformValue("texture1", 1);
+    pProgram->setUniformValue("mvp_matrix", m);
+    pProgram->setUniformValue("borderColor", borderColor);
+
+    pTransition->pVao = new QOpenGLVertexArrayObject();
+    if(pTransition->pVao->create()) {
+        QOpenGLVertexArrayObject::Binder vaoBinder(pTransition->pVao);
+        arrayBuf.bind();
+        indexBuf.bind();
+        setVertexAttributes(*pTransition);
+    }
+    else { // OpenGL ES 2.0 without OES_vertex_array_object
+        delete pTransition->pVao;
+        pTransition->pVao = nullptr;
+    }
+    pProgram->release();
+    return true;
+}
+
+
+void
+SlideTransitions::setVertexAttributes(const Transition& transition) {
+    QOpenGLShaderProgram* pProgram = transition.pProgram;
+
+    // Offset for position
+    quintptr offset = 0;
+
+    // Tell OpenGL programmable pipeline how to locate vertex position data
+    pProgram->enableAttributeArray(transition.iPositionLoc);
+    pProgram->setAttributeBuffer(transition.iPositionLoc, GL_FLOAT, offset, 3, sizeof(TransitionVertex));
+
+    // Offset for texture coordinate
+    offset += sizeof(QVector3D);
+
+    // Tell OpenGL programmable pipeline how to locate vertex texture coordinate data
+    pProgram->enableAttributeArray(transition.iTexcoordLoc);
+    pProgram->setAttributeBuffer(transition.iTexcoordLoc, GL_FLOAT, offset, 2, sizeof(TransitionVertex));
+}
+
+
+// The program of the current transition (built again if the
+// letterbox mode changed): if it does not build another is chosen.
+QOpenGLShaderProgram*
+SlideTransitions::currentProgram() {
+    if(bStalePrograms)
+        releasePrograms();
+    QOpenGLShaderProgram* pProgram = transitionProgram(iCurrent);
+    if(!pProgram)
+        pProgram = nextTransition();
+    return pProgram;
+}
+
+
+// The governor chooses the next transition: if it does not build
+// another one is chosen. Returns nullptr only if none is usable.
+QOpenGLShaderProgram*
+SlideTransitions::nextTransition() {
+    if(bStalePrograms)
+        releasePrograms();
+    for(int i=0; i<transitions.count(); i++) {
+        iCurrent = governor.chooseTransition();
+        QOpenGLShaderProgram* pProgram = transitionProgram(iCurrent);
+        if(pProgram)
+            return pProgram;
+    }
+    return nullptr;
+}
+
+
+QString
+SlideTransitions::currentName() const {
+    return transitionTable.value(iCurrent).sShader;
+}
+
+
+// Builds one of the transitions still missing.
+// Returns false when there is nothing left to build.
+bool
+SlideTransitions::prewarm() {
+    if(bStalePrograms)
+        releasePrograms();
+    for(int i=0; i<transitions.count(); i++) {
+        if(!transitions.at(i).pProgram && governor.isUsable(i)) {
+            transitionProgram(i); // Disabled if it fails
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Computes where the slide in pTexture will be shown.
+// The rect maps screen uv to slide uv: a negative height flips
+// the (top-down) image while the extent is the part of the texture
+// filled by the slide.
+void
+SlideTransitions::placeSlide(QOpenGLTexture* pTexture, QSize slideSize) {
+    bPlacementChanged = true;
+    if(!bGpuLetterbox) { // Already composed, mirrored and fullscreen
+        slideRects.insert(pTexture, QVector4D(0.0f, 0.0f, 1.0f, 1.0f));
+        slideExtents.insert(pTexture, QVector2D(1.0f, 1.0f));
+        return;
+    }
+    QSizeF fitSize = QSizeF(slideSize).scaled(QSizeF(panelSize), Qt::KeepAspectRatio);
+    float sx = float(fitSize.width()  / panelSize.width());
+    float sy = float(fitSize.height() / panelSize.height());
+    float x0 = 0.5f * (1.0f - sx);
+    float y0 = 0.5f * (1.0f - sy);
+    slideRects.insert(pTexture, QVector4D(x0, y0+sy, sx, -sy));
+    slideExtents.insert(pTexture, QVector2D(float(slideSize.width())  / pTexture->width(),
+                                            float(slideSize.height()) / pTexture->height()));
+}
+
+
+// Slide placement uniforms: they change only when
+// the textures or the transition are switched.
+void
+SlideTransitions::setSlideUniforms(const Transition& transition,
+                                   QOpenGLTexture* pTexture0,
+                                   QOpenGLTexture* pTexture1)
+{
+    QOpenGLShaderProgram* pProgram = transition.pProgram;
+    QVector2D extent0 = slideExtents.value(pTexture0, QVector2D(1.0f, 1.0f));
+    QVector2D extent1 = slideExtents.value(pTexture1, QVector2D(1.0f, 1.0f));
+    pProgram->setUniformValue(transition.iTexRect0Loc,
+                              slideRects.value(pTexture0, QVector4D(0.0f, 0.0f, 1.0f, 1.0f)));
+    pProgram->setUniformValue(transition.iTexRect1Loc,
+                              slideRects.value(pTexture1, QVector4D(0.0f, 0.0f, 1.0f, 1.0f)));
+    pProgram->setUniformValue(transition.iTexExtentLoc,
+                              QVector4D(extent0.x(), extent0.y(), extent1.x(), extent1.y()));
+}
+
+
+// One frame of the current transition from pTexture0 (progress 0)
+// to pTexture1 (progress 1)
+void
+SlideTransitions::draw(QOpenGLTexture* pTexture0, QOpenGLTexture* pTexture1, GLfloat progress) {
+    QOpenGLShaderProgram* pProgram = currentProgram();
+    if(!pProgram || !pTexture0 || !pTexture1)
+        return;
+    const Transition& transition = transitions.at(iCurrent);
+    pTexture0->bind(0);
+    pTexture1->bind(1);
+    pProgram->bind();
+    if(bPlacementChanged ||
+       (pTexture0 != pPlacedTexture0) ||
+       (pTexture1 != pPlacedTexture1) ||
+       (iCurrent  != iPlacedTransition))
+    {
+        setSlideUniforms(transition, pTexture0, pTexture1);
+        pPlacedTexture0   = pTexture0;
+        pPlacedTexture1   = pTexture1;
+        iPlacedTransition = iCurrent;
+        bPlacementChanged = false;
+    }
+    pProgram->setUniformValue(transition.iProgressLoc, progress);
+
+    const MeshRange& range = meshRanges[transition.mesh];
+    const void* pFirstIndex = reinterpret_cast<const void*>(quintptr(range.iFirstIndex*sizeof(quint16)));
+    if(transition.pVao) {
+        QOpenGLVertexArrayObject::Binder vaoBinder(transition.pVao);
+        glDrawElements(GL_TRIANGLES, range.nIndices, GL_UNSIGNED_SHORT, pFirstIndex);
+    }
+    else {
+        // Tell OpenGL which VBOs to use
+        arrayBuf.bind();
+        indexBuf.bind();
+        setVertexAttributes(transition);
+        glDrawElements(GL_TRIANGLES, range.nIndices, GL_UNSIGNED_SHORT, pFirstIndex);
+    }
+    pProgram->release();
+    pTexture0->release();
+    pTexture1->release();
+}
+
+
+void
+SlideTransitions::transitionDone(int nFrames, int nDropped, double msElapsed) {
+    governor.transitionDone(iCurrent, nFrames, nDropped, msElapsed);
+}
+
+
+void
+SlideTransitions::logState() const {
+    governor.logState();
+}
+
+
+void
+SlideTransitions::releasePrograms() {
+    for(int i=0; i<transitions.count(); i++) {
+        delete transitions.at(i).pVao;
+        delete transitions.at(i).pProgram;
+    }
+    transitions.fill(Transition());
+    bStalePrograms    = false;
+    bPlacementChanged = true;
+}
+
+
+void
+SlideTransitions::cleanup() {
+    releasePrograms();
+    transitions.clear();
+    slideRects.clear();
+    slideExtents.clear();
+    pPlacedTexture0 = nullptr;
+    pPlacedTexture1 = nullptr;
+    arrayBuf.destroy();
+    indexBuf.destroy();
+}
@@ -0,0 +1,108 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLTexture>
+#include <QOpenGLBuffer>
+#include <QOpenGLVertexArrayObject>
+#include <QMatrix4x4>
+#include <QVector4D>
+#include <QVector2D>
+#include <QVector>
+#include <QHash>
+#include <QColor>
+#include <QFile>
+
+#include "transitionlist.h"
+#include "transitiongovernor.h"
+
+
+// The OpenGL core of the Slide Show, shared by SlideWidget (drawing
+// in the GUI thread) and SlideRenderer (drawing in its own thread):
+// the transition programs, built on first use and chosen by the
+// governor, the meshes they draw and where the slides are placed
+// in their textures. Everything but the setters must be called
+// with the OpenGL context current.
+class SlideTransitions : protected QOpenGLFunctions
+{
+public:
+    explicit SlideTransitions(QFile* myLogFile = nullptr);
+
+public:
+    void initialize(QSize newPanelSize, double refreshRate);
+    void setGpuLetterbox(bool bEnable);
+    QString shaderDir() const;
+    QOpenGLShaderProgram* currentProgram();
+    QOpenGLShaderProgram* nextTransition();
+    QString currentName() const;
+    bool prewarm();
+    void placeSlide(QOpenGLTexture* pTexture, QSize slideSize);
+    void draw(QOpenGLTexture* pTexture0, QOpenGLTexture* pTexture1, GLfloat progress);
+    void transitionDone(int nFrames, int nDropped, double msElapsed);
+    void logState() const;
+    void cleanup();
+
+private:
+    struct Transition {
+        QOpenGLShaderProgram*     pProgram      = nullptr;
+        QOpenGLVertexArrayObject* pVao          = nullptr;
+        GLint                     iPositionLoc  = -1;
+        GLint                     iTexcoordLoc  = -1;
+        GLint                     iProgressLoc  = -1;
+        GLint                     iTexRect0Loc  = -1;
+        GLint                     iTexRect1Loc  = -1;
+        GLint                     iTexExtentLoc = -1;
+        transitionMesh            mesh          = fullScreenMesh;
+    };
+
+private:
+    void initGeometry();
+    void initShaders();
+    QOpenGLShaderProgram* transitionProgram(int iTransition);
+    bool bakeTransition(Transition* pTransition);
+    void setVertexAttributes(const Transition& transition);
+    void setSlideUniforms(const Transition& transition,
+                          QOpenGLTexture* pTexture0,
+                          QOpenGLTexture* pTexture1);
+    void releasePrograms();
+
+private:
+    QFile*                 pLogFile;
+    QString                sShaderDir;
+    QList<TransitionEntry> transitionTable;
+    QVector<Transition>    transitions;
+    int                    iCurrent;
+    QOpenGLBuffer          arrayBuf;
+    QOpenGLBuffer          indexBuf;
+    MeshRange              meshRanges[nTransitionMeshes];
+    QHash<QOpenGLTexture*, QVector4D> slideRects;
+    QHash<QOpenGLTexture*, QVector2D> slideExtents;
+    QOpenGLTexture*        pPlacedTexture0;
+    QOpenGLTexture*        pPlacedTexture1;
+    int                    iPlacedTransition;
+    QMatrix4x4             m;
+    QColor                 borderColor;
+    QSize                  panelSize;
+    bool                   bGpuLetterbox;
+    bool                   bStalePrograms;
+    bool                   bPlacementChanged;
+    TransitionGovernor     governor;
+};
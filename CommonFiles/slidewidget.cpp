@@ -19,6 +19,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define _USE_MATH_DEFINES 1
 
 #include "slidewidget.h"
+#include "slideprefetcher.h"
+#include "slidecache.h"
+#include "spotplayer.h"
+#include "utility.h"
 
 
 #include <QMouseEvent>
@@ -28,19 +32,65 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QStandardPaths>
 #include <QTime>
 #include <QScreen>
+#include <QElapsedTimer>
+#include <QOpenGLContext>
+#if !QT_CONFIG(opengles2)
+#include <QOpenGLTimerQuery>
+#endif
 
 
 #define STEADY_SHOW_TIME       3000 // Change slide time
-#define UPDATE_TIME              30 // Time between screen updates
-
-
-SlideWidget::SlideWidget()
+#define TRANSITION_TIME        1500 // Default transition duration
+#define PREFETCH_RETRY_TIME     250 // Next look at the prefetch queue when it was empty
+#define TEXTURE_POOL_SIZE         2 // Slide textures ping-ponged by the transitions
+#define PREWARM_TIME            250 // Time between idle transition builds
+#define PREFETCH_DEPTH            3 // Slides composed ahead when memory is not a problem
+#define MEGABYTE            1048576
+#define RESCAN_DELAY           1000 // Wait for the copies in the slide dir to settle
+#define GPU_TIMER_QUERIES         3 // Queries in flight: results are read some frames later
+
+
+// From the best to the smallest: the slides are opaque so
+// formats without alpha can be used when memory is short.
+const SlideWidget::SlideFormat SlideWidget::slideFormats[] = {
+    {QImage::Format_RGBA8888_Premultiplied, QOpenGLTexture::RGBA8_UNorm,
+     QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, 4, "RGBA8888"},
+    {QImage::Format_RGB888, QOpenGLTexture::RGB8_UNorm,
+     QOpenGLTexture::RGB, QOpenGLTexture::UInt8, 3, "RGB888"},
+    {QImage::Format_RGB16, QOpenGLTexture::R5G6B5,
+     QOpenGLTexture::RGB, QOpenGLTexture::UInt16_R5G6B5, 2, "RGB565"},
+};
+
+
+SlideWidget::SlideWidget(QFile *myLogFile)
     : QOpenGLWidget()
-    , arrayBuf(QOpenGLBuffer::VertexBuffer)
+    , pLogFile(myLogFile)
+    , pixelBuf(QOpenGLBuffer::PixelUnpackBuffer)
+    , bPboSupported(false)
+    , bPboUpload(false)
     , bRunning(false)
-    , pBaseImage(nullptr)
+    , bAnimating(false)
+    , bNextSlideReady(false)
+    , msTransitionTime(TRANSITION_TIME)
+    , nTransitionFrames(0)
+    , nDroppedFrames(0)
+    , bGpuLetterbox(false)
+    , pPrefetcher(new SlidePrefetcher(this))
+    , bSlideCache(false)
+    , pSlideCache(new SlideCache(this))
+    , pSpotPlayer(nullptr)
+    , bShowingSpots(false)
+    , iGpuTimer(0)
+    , bStatsOverlay(false)
+    , mbMemoryBudget(0)
+    , iSlideFormat(0)
+    , slideTransitions(myLogFile)
+    , bScoreTicker(false)
+    , bTextureCompression(false)
+    , compression(TextureCompressor::NoCompression)
 {
     srand(QTime::currentTime().msec());
+    iCurrentSlide = 0;
     sSlideDir = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation);
     updateSlideList();
 
@@ -53,26 +103,38 @@ SlideWidget::SlideWidget()
         QPoint point = QPoint(screenres.x(), screenres.y());
         move(point);
     }
-    pBaseImage = new QImage(screenres.width(),
-                            screenres.height(),
-                            QImage::Format_RGBA8888_Premultiplied);
-
-    m.ortho(-1.0f, +1.0f, -1.0f, 1.0f, 4.0f, 15.0f);
-    m.translate(0.0f, 0.0f, -10.0);
-
-    iCurrentSlide    = 0;
+    panelSize = screenres.size();
+    pPrefetcher->setPanelSize(panelSize);
+    pPrefetcher->start(QThread::LowPriority);
 
     setCursor(Qt::BlankCursor);
 
     timerSteady.setSingleShot(true);
-    connect(&timerAnimate, SIGNAL(timeout()),
-            this, SLOT(ontimerAnimateEvent()));
+    // The animation is paced by the display refresh
+    connect(this, SIGNAL(frameSwapped()),
+            this, SLOT(onFrameSwapped()));
     connect(&timerSteady, SIGNAL(timeout()),
             this, SLOT(onTimerSteadyEvent()));
+    connect(&timerPrewarm, SIGNAL(timeout()),
+            this, SLOT(onTimerPrewarmEvent()));
+    // Slides can be added or removed while the show is running
+    timerRescan.setSingleShot(true);
+    connect(&slideDirWatcher, SIGNAL(directoryChanged(QString)),
+            this, SLOT(onSlideDirChanged()));
+    connect(&timerRescan, SIGNAL(timeout()),
+            this, SLOT(onTimerRescanEvent()));
 }
 
 
 SlideWidget::~SlideWidget() {
+    pSlideCache->stop();
+    if(pSpotPlayer) {
+        pSpotPlayer->stopSpots();
+        pSpotPlayer->stopPlayer();
+        pSpotPlayer->wait();
+    }
+    pPrefetcher->stopPrefetch();
+    pPrefetcher->wait();
     cleanOpenGL();
 }
 
@@ -86,28 +148,76 @@ SlideWidget::closeEvent(QCloseEvent* event) {
 
 void
 SlideWidget::cleanOpenGL() {
+    timerPrewarm.stop();
     makeCurrent();
-    if(pTexture0) delete pTexture0;
     pTexture0 = nullptr;
-    if(pTexture1) delete pTexture1;
     pTexture1 = nullptr;
-    for(int i=0; i<pPrograms.count(); i++)
-        delete pPrograms.at(i);
-    pPrograms.clear();
-    arrayBuf.destroy();
+    for(int i=0; i<texturePool.count(); i++)
+        delete texturePool.at(i);
+    texturePool.clear();
+    pixelBuf.destroy();
+    slideTransitions.cleanup();
+    for(int i=0; i<gpuTimers.count(); i++)
+        delete gpuTimers.at(i);
+    gpuTimers.clear();
+    gpuTimerTransition.clear();
+    scoreTicker.cleanup();
     doneCurrent();
 }
 
 
+// Switch between the synchronous and the Pixel Buffer Object
+// texture upload. Can be changed while the Slide Show is running.
+void
+SlideWidget::setPboUpload(bool bEnable) {
+    bPboUpload = bEnable;
+}
+
+
+// With the GPU letterbox the slides are uploaded at their decoded
+// size: aspect fit, vertical flip and border color are done by the
+// transition shaders (see getFromColor() and getToColor() in the
+// fragment shaders) instead of compositing a full panel image.
+void
+SlideWidget::setGpuLetterbox(bool bEnable) {
+    if(bEnable == bGpuLetterbox)
+        return;
+    bGpuLetterbox = bEnable;
+    pPrefetcher->setGpuLetterbox(bEnable);
+    if(bSlideCache) // The cached slides depend on the letterbox mode
+        pSlideCache->update(slideList, panelSize, bGpuLetterbox, compression,
+                            slideFormats[iSlideFormat].imageFormat);
+    slideTransitions.setGpuLetterbox(bEnable); // The shaders too
+    timerPrewarm.start(PREWARM_TIME);
+}
+
+
+// With the Slide Cache each slide is decoded and composed only once
+// (in background, on all the cores) and then memory mapped from the
+// cache file at every round: no decoding while the show is running.
+void
+SlideWidget::setSlideCache(bool bEnable) {
+    if(bEnable == bSlideCache)
+        return;
+    bSlideCache = bEnable;
+    pPrefetcher->setSlideCache(bEnable);
+    if(bSlideCache)
+        pSlideCache->update(slideList, panelSize, bGpuLetterbox, compression,
+                            slideFormats[iSlideFormat].imageFormat);
+    else
+        pSlideCache->stop();
+}
+
+
 bool
 SlideWidget::setSlideDir(QString sNewDir) {
     if(sNewDir != sSlideDir) {
         if(timerSteady.isActive())  timerSteady.stop();
-        if(timerAnimate.isActive()) timerAnimate.stop();
+        bAnimating = false;
         sSlideDir = sNewDir;
+        iCurrentSlide = 0;
         if(!updateSlideList())
             return false;
-        iCurrentSlide = 0;
     }
     if(bRunning)
         return startSlideShow();
@@ -116,33 +226,53 @@ SlideWidget::setSlideDir(QString sNewDir) {
 }
 
 
+// The widget shown before the Slide Show: it will be
+// the starting image of the first transition.
+void
+SlideWidget::setScorePanel(QWidget* pPanel) {
+    pScorePanel = pPanel;
+}
+
+
 void
 SlideWidget::showFullScreen() {
-    // Let's Capture a Screenshot of the panel as the first image
-    QImage tempImage = QImage(pMyScreen->geometry().width(),
-                              pMyScreen->geometry().height(),
-                              QImage::Format_RGBA8888_Premultiplied);
-    QPainter painter(&tempImage);
-    painter.fillRect(tempImage.rect(), Qt::white);
-    QImage image = pMyScreen->grabWindow(0).toImage();
-    if(!image.isNull()) {
-        image = image.scaled(pBaseImage->size(),
-                             Qt::KeepAspectRatio).mirrored();
-        int x = (tempImage.width()  - image.width())  / 2;
-        int y = (tempImage.height() - image.height()) / 2;
-        painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-        painter.drawImage(x, y, image);
+    // The first image is the score panel rendered by itself at its
+    // native size: no desktop grab (slow on X11 and unreliable with
+    // compositors). The screen is grabbed only if we have no panel.
+    QImage tempImage;
+    QImage image;
+    if(pScorePanel && pScorePanel->isVisible())
+        image = pScorePanel->grab().toImage();
+    else
+        image = pMyScreen->grabWindow(0).toImage();
+    if(bGpuLetterbox && !image.isNull()) {
+        tempImage = image;
+    }
+    else if(image.size() == panelSize) { // Nothing to scale or center
+        tempImage = image.mirrored();
+    }
+    else {
+        tempImage = QImage(panelSize, QImage::Format_RGBA8888_Premultiplied);
+        QPainter painter(&tempImage);
+        painter.fillRect(tempImage.rect(), Qt::white);
+        if(!image.isNull()) {
+            image = image.scaled(panelSize,
+                                 Qt::KeepAspectRatio).mirrored();
+            int x = (tempImage.width()  - image.width())  / 2;
+            int y = (tempImage.height() - image.height()) / 2;
+            painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+            painter.drawImage(x, y, image);
+        }
+        painter.end();
     }
-    painter.end();
     // Now we are ready to initializie OpenGl (if not already done)
     QOpenGLWidget::showFullScreen();
     // The very first texture is a screenshot of the panel
-    // captured from SlideWidget::showFullScreen() in pBaseImage
+    // captured from SlideWidget::showFullScreen() in tempImage
     makeCurrent();
-    pTexture0 = new QOpenGLTexture(tempImage);
-    pTexture0->setMinificationFilter(QOpenGLTexture::Nearest);
-    pTexture0->setMagnificationFilter(QOpenGLTexture::Linear);
-    pTexture0->setWrapMode(QOpenGLTexture::Repeat);
+    pTexture0 = freeTexture();
+    if(pTexture0)
+        uploadSlide(pTexture0, tempImage);
     doneCurrent();
 }
 
@@ -150,18 +280,24 @@ SlideWidget::showFullScreen() {
 bool
 SlideWidget::startSlideShow() {
     makeCurrent();
-    pCurrentProgram = pPrograms.at(currentAnimation);
-    if(!pCurrentProgram->bind()) {
+    QOpenGLShaderProgram* pProgram = slideTransitions.currentProgram();
+    doneCurrent();
+    if(!pProgram) {
         qCritical() << __FUNCTION__ << __LINE__;
         close();
         return false;
     }
-    getLocations();
-    doneCurrent();
-    setWindowTitle(pCurrentProgram->objectName());
-    progress = 0.0f;
-    update();
-    timerAnimate.start(UPDATE_TIME);
+    setWindowTitle(pProgram->objectName());
+#ifdef LOG_MESG
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("Slide memory: %1 MB")
+               .arg(double(memoryFootprint())/MEGABYTE, 0, 'f', 1));
+#endif
+    if(bNextSlideReady)
+        startTransition();
+    else
+        timerSteady.start(PREFETCH_RETRY_TIME);
     bRunning = true;
     return true;
 }
@@ -170,330 +306,838 @@ SlideWidget::startSlideShow() {
 void
 SlideWidget::stopSlideShow() {
     timerSteady.stop();
-    timerAnimate.stop();
-    makeCurrent();
-    pTexture1->release();
-    delete pTexture1;
-    pTexture0->release();
+    bAnimating = false;
+    // The slide on screen will be the target of the first
+    // transition when the Slide Show restarts
     pTexture1 = pTexture0;
     pTexture0 = nullptr;
-    doneCurrent();
+    bNextSlideReady = true;
     bRunning = false;
+#ifdef LOG_MESG
+    logTransitionStats();
+    slideTransitions.logState();
+#endif
 }
 
 
-bool
-SlideWidget::updateSlideList() {
-    slideList = QFileInfoList();
+QFileInfoList
+SlideWidget::scanSlideDir() {
     QDir slideDir(sSlideDir);
-    if(slideDir.exists()) {
-        QStringList nameFilter = QStringList() << "*.jpg" << "*.jpeg" << "*.png";
-        slideDir.setNameFilters(nameFilter);
-        slideDir.setFilter(QDir::Files);
-        slideList = slideDir.entryInfoList();
+    if(!slideDir.exists())
+        return QFileInfoList();
+    QStringList nameFilter = QStringList() << "*.jpg" << "*.jpeg" << "*.png";
+    slideDir.setNameFilters(nameFilter);
+    slideDir.setFilter(QDir::Files);
+    return slideDir.entryInfoList();
+}
+
+
+void
+SlideWidget::watchSlideDir() {
+    timerRescan.stop();
+    if(!slideDirWatcher.directories().isEmpty())
+        slideDirWatcher.removePaths(slideDirWatcher.directories());
+    if(QDir(sSlideDir).exists())
+        slideDirWatcher.addPath(sSlideDir);
+}
+
+
+// Many events arrive while a slide is being copied:
+// the directory is read again only when they stop.
+void
+SlideWidget::onSlideDirChanged() {
+    timerRescan.start(RESCAN_DELAY);
+}
+
+
+// Only the differences with the current list are applied: the slides
+// already prefetched are kept, new slides are prepared in background
+// and the running show goes on from the same slide.
+void
+SlideWidget::onTimerRescanEvent() {
+    QFileInfoList newList = scanSlideDir();
+    int nAdded = 0;
+    int nRemoved = 0;
+    for(const QFileInfo& slide : std::as_const(newList)) {
+        int i = slideList.indexOf(slide);
+        if((i < 0) ||
+           (slideList.at(i).size() != slide.size()) ||
+           (slideList.at(i).lastModified() != slide.lastModified()))
+            nAdded++;
+    }
+    for(const QFileInfo& slide : std::as_const(slideList)) {
+        if(!newList.contains(slide))
+            nRemoved++;
+    }
+    if((nAdded == 0) && (nRemoved == 0))
+        return;
+#ifdef LOG_MESG
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("%1 slides added or changed, %2 removed")
+               .arg(nAdded)
+               .arg(nRemoved));
+#endif
+    // Keep showing from the slide that was coming next
+    int iNext = 0;
+    if(!slideList.isEmpty()) {
+        iNext = newList.indexOf(slideList.at(iCurrentSlide % slideList.count()));
+        if(iNext < 0)
+            iNext = newList.isEmpty() ? 0 : iCurrentSlide % newList.count();
+    }
+    slideList = newList;
+    iCurrentSlide = iNext;
+    if(slideList.isEmpty())
+        pPrefetcher->setSlideList(QFileInfoList({QFileInfo(":/CommonFiles/Loghi/Logo_UniMe.png")}), 0);
+    else
+        pPrefetcher->updateSlideList(slideList);
+    if(bSlideCache)
+        pSlideCache->update(slideList, panelSize, bGpuLetterbox, compression,
+                            slideFormats[iSlideFormat].imageFormat);
+}
+
+
+// The spots are played in this same window: every spot enters
+// with one of the slide transitions and then the video frames
+// keep refreshing the texture on the screen.
+bool
+SlideWidget::startSpotShow(const QFileInfoList& spots, int iFirstSpot) {
+    if(spots.isEmpty())
+        return false;
+    timerSteady.stop();
+    bAnimating = false;
+    if(!pSpotPlayer) { // Only the panels showing the spots need its thread
+        pSpotPlayer = new SpotPlayer(pLogFile, this);
+        connect(pSpotPlayer, SIGNAL(frameReady()),
+                this, SLOT(onVideoFrameReady()));
+        pSpotPlayer->start();
+    }
+    pSpotPlayer->setPanelSize(panelSize);
+    pSpotPlayer->setGpuLetterbox(bGpuLetterbox);
+    pSpotPlayer->setImageFormat(slideFormats[iSlideFormat].imageFormat);
+    bShowingSpots = true;
+    pVideoTexture = nullptr;
+    return pSpotPlayer->startSpots(spots, iFirstSpot);
+}
+
+
+void
+SlideWidget::stopSpotShow() {
+    if(pSpotPlayer)
+        pSpotPlayer->stopSpots();
+    bShowingSpots = false;
+    bAnimating = false;
+    pVideoTexture = nullptr;
+    // As for the slides: what is on the screen will
+    // be the first image of the next show
+    pTexture1 = pTexture0;
+    pTexture0 = nullptr;
+    bNextSlideReady = true;
+}
+
+
+int
+SlideWidget::currentSpot() const {
+    if(!pSpotPlayer)
+        return -1;
+    return pSpotPlayer->currentSpot();
+}
+
+
+void
+SlideWidget::onVideoFrameReady() {
+    QImage frame;
+    bool bNewSpot;
+    if(!bShowingSpots || !pSpotPlayer || !pSpotPlayer->takeFrame(&frame, &bNewSpot))
+        return;
+    if(!pTexture0) // Not yet shown
+        return;
+    makeCurrent();
+    if((bNewSpot || !pVideoTexture) && !bAnimating) {
+        // The texture not on the screen gets the new spot
+        pVideoTexture = nullptr;
+        for(int i=0; i<texturePool.count(); i++) {
+            if(texturePool.at(i) != pTexture0)
+                pVideoTexture = texturePool.at(i);
+        }
+        if(pVideoTexture) {
+            pTexture1 = pVideoTexture;
+            uploadSlide(pVideoTexture, frame);
+            startSpotTransition();
+        }
+    }
+    else if(pVideoTexture) {
+        uploadSlide(pVideoTexture, frame);
+        if(!bAnimating)
+            update();
+    }
+    doneCurrent();
+}
+
+
+// Must be called with the OpenGL context current
+void
+SlideWidget::startSpotTransition() {
+    QOpenGLShaderProgram* pProgram = slideTransitions.nextTransition();
+    if(!pProgram) { // No transition at all
+        close();
+        return;
     }
+    setWindowTitle(pProgram->objectName());
+    startTransition();
+}
+
+
+// The playing spot is now the texture shown at progress 0
+void
+SlideWidget::endSpotTransition() {
+    pTexture1 = pTexture0;
+    pTexture0 = pVideoTexture;
+}
+
+
+bool
+SlideWidget::updateSlideList() {
+    slideList = scanSlideDir();
+    watchSlideDir();
+    if(slideList.isEmpty())
+        pPrefetcher->setSlideList(QFileInfoList({QFileInfo(":/CommonFiles/Loghi/Logo_UniMe.png")}), 0);
+    else
+        pPrefetcher->setSlideList(slideList, iCurrentSlide);
+    // Only new or modified slides will be processed
+    if(bSlideCache)
+        pSlideCache->update(slideList, panelSize, bGpuLetterbox, compression,
+                            slideFormats[iSlideFormat].imageFormat);
     return !slideList.isEmpty();
 }
 
 
+// Never waits for the prefetcher: when its queue is empty
+// the slide on the screen just stays there a little longer.
 bool
 SlideWidget::prepareNextSlide() {
-    QImage newImage;
     if(slideList.isEmpty())
         slideList.append(QFileInfo(":/CommonFiles/Loghi/Logo_UniMe.png"));
-    newImage.load(slideList.at(iCurrentSlide).absoluteFilePath());
-    image = newImage.scaled(pBaseImage->size(),
-                            Qt::KeepAspectRatio).mirrored();
-    QPainter painter(pBaseImage);
-    painter.fillRect(pBaseImage->rect(), Qt::white);
-    int x = (pBaseImage->width()  - image.width())  / 2;
-    int y = (pBaseImage->height() - image.height()) / 2;
-    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-    painter.drawImage(x, y, image);
-    painter.end();
-
+    nextCompressed = CompressedImage();
+    if(!pPrefetcher->takeSlide(&nextSlide, 0, &nextCompressed))
+        return false;
     iCurrentSlide = (iCurrentSlide + 1) % slideList.count();
     return true;
 }
 
 
+// Puts the next slide, if already prefetched, in pTexture1.
+// Must be called with the OpenGL context current.
+bool
+SlideWidget::takeNextSlide() {
+    bNextSlideReady = prepareNextSlide();
+    if(bNextSlideReady)
+        uploadNextSlide(pTexture1);
+    return bNextSlideReady;
+}
+
+
 bool
 SlideWidget::prepareNextRound() {
     makeCurrent(); // Fondamentale !!!
-//    currentAnimation = nAnimationTypes-1;
-    currentAnimation = rand() % nAnimationTypes;
-    pCurrentProgram->release();
-    pCurrentProgram = pPrograms.at(currentAnimation);
-    getLocations();
-
-    // Prepare the next slide...
-    if(!prepareNextSlide()) {
+    QOpenGLShaderProgram* pProgram = slideTransitions.nextTransition();
+    if(!pProgram) { // No transition at all
         close();
         return false;
     }
-    pTexture0->release();
-    delete pTexture0;
-    pTexture1->release();
+
+    // Ping-pong: the texture just left the screen gets the new slide
+    QOpenGLTexture* pFreeTexture = pTexture0;
     pTexture0 = pTexture1;
-    pTexture1 = new QOpenGLTexture(*pBaseImage);
-    pTexture1->setMinificationFilter(QOpenGLTexture::Nearest);
-    pTexture1->setMagnificationFilter(QOpenGLTexture::Linear);
-    pTexture1->setWrapMode(QOpenGLTexture::Repeat);
+    pTexture1 = pFreeTexture;
+    takeNextSlide(); // If not yet ready it is retried by onTimerSteadyEvent()
     doneCurrent();
-    setWindowTitle(pCurrentProgram->objectName());
+    setWindowTitle(pProgram->objectName());
     timerSteady.start(STEADY_SHOW_TIME);
     return true;
 }
 
 
-bool
-SlideWidget::getLocations() {
-    if(!pCurrentProgram->isLinked()) {
-        qCritical() << "Program not linked";
-        close();
-        return false;
-    }
-    int vertexLocation   = pCurrentProgram->attributeLocation("a_position");
-    int texcoordLocation = pCurrentProgram->attributeLocation("a_texcoord");
-    if((vertexLocation   == -1) || (texcoordLocation == -1)) {
-        qCritical() << "Shader attributes not found";
+void
+SlideWidget::initializeGL() {
+    initializeOpenGLFunctions();
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+
+    // Only the first transition is built now: the others
+    // are built on first use or when idle (see onTimerPrewarmEvent())
+    slideTransitions.initialize(panelSize, pMyScreen->refreshRate());
+    timerPrewarm.start(PREWARM_TIME);
+    initTextures();
+    initTimerQueries();
+    scoreTicker.initialize(slideTransitions.shaderDir(), panelSize);
+
+    if(!slideTransitions.currentProgram()) {
+        qCritical() << __FUNCTION__ << __LINE__;
         close();
-        return false;
+        return;
     }
+}
 
-    // Offset for position
-    quintptr offset = 0;
 
-    // Tell OpenGL programmable pipeline how to locate vertex position data
-    pCurrentProgram->enableAttributeArray(vertexLocation);
-    pCurrentProgram->setAttributeBuffer(vertexLocation, GL_FLOAT, offset, 3, sizeof(VertexData));
+// Builds one of the missing transitions while nothing is moving
+void
+SlideWidget::onTimerPrewarmEvent() {
+    if(bAnimating)
+        return;
+    makeCurrent();
+    bool bMore = slideTransitions.prewarm();
+    doneCurrent();
+    if(!bMore)
+        timerPrewarm.stop();
+}
 
-    // Offset for texture coordinate
-    offset += sizeof(QVector3D);
 
-    // Tell OpenGL programmable pipeline how to locate vertex texture coordinate data
-    pCurrentProgram->enableAttributeArray(texcoordLocation);
-    pCurrentProgram->setAttributeBuffer(texcoordLocation, GL_FLOAT, offset, 2, sizeof(VertexData));
+// Called just once in SlideWidget::initializeGL()
+void
+SlideWidget::initTextures() {
+    // The very first texture is a screenshot of the panel
+    // captured from SlideWidget::showFullScreen()
+    // Now we get the second texture
+    initTexturePool();
+    pTexture1 = freeTexture();
+    takeNextSlide();
+}
 
-    iTex0Loc = pCurrentProgram->uniformLocation("texture0");
-    iTex1Loc = pCurrentProgram->uniformLocation("texture1");
 
-    iProgressLoc = pCurrentProgram->uniformLocation("progress");
-    if(iProgressLoc == -1) {
-        qCritical() << __FUNCTION__ << __LINE__ << "Shader uniform not found";
-        close();
-        return false;
+// The slide textures are allocated just once at panel resolution
+// (immutable storage where available) and then only refilled.
+void
+SlideWidget::initTexturePool() {
+    chooseSlideFormat();
+    chooseCompression();
+    const SlideFormat& slideFormat = slideFormats[iSlideFormat];
+    for(int i=0; i<TEXTURE_POOL_SIZE; i++) {
+        QOpenGLTexture* pTexture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+        allocateSlideTexture(pTexture);
+        texturePool.append(pTexture);
+    }
+    // Pixel Buffer Objects are core in OpenGL 2.1 and OpenGL ES 3.0
+    QOpenGLContext* pContext = QOpenGLContext::currentContext();
+    if(pContext->isOpenGLES())
+        bPboSupported = pContext->format().majorVersion() >= 3;
+    else
+        bPboSupported = (pContext->format().version() >= qMakePair(2, 1)) ||
+                        pContext->hasExtension("GL_ARB_pixel_buffer_object");
+    if(bPboSupported) {
+        bPboSupported = pixelBuf.create();
+        if(bPboSupported) {
+            pixelBuf.setUsagePattern(QOpenGLBuffer::StreamDraw);
+            pixelBuf.bind();
+            pixelBuf.allocate(panelSize.width()*panelSize.height()*slideFormat.nBytesPerPixel);
+            pixelBuf.release();
+        }
     }
-    progress = 0.0;
-
-    return true;
 }
 
 
+// (Re)allocates the texture storage for the uncompressed slides.
+// Must be called with the OpenGL context current.
 void
-SlideWidget::drawGeometry(QOpenGLShaderProgram *program) {
-    // Tell OpenGL which VBOs to use
-    arrayBuf.bind();
+SlideWidget::allocateSlideTexture(QOpenGLTexture* pTexture) {
+    const SlideFormat& slideFormat = slideFormats[iSlideFormat];
+    if(pTexture->isCreated())
+        pTexture->destroy();
+    pTexture->setFormat(slideFormat.textureFormat);
+    pTexture->setSize(panelSize.width(), panelSize.height());
+    pTexture->setMipLevels(1);
+    pTexture->allocateStorage(slideFormat.pixelFormat, slideFormat.pixelType);
+    pTexture->setMinificationFilter(QOpenGLTexture::Nearest);
+    pTexture->setMagnificationFilter(QOpenGLTexture::Linear);
+    pTexture->setWrapMode(QOpenGLTexture::Repeat);
+}
 
-    // Offset for position
-    quintptr offset = 0;
 
-    // Tell OpenGL programmable pipeline how to locate vertex position data
-    int vertexLocation = program->attributeLocation("a_position");
-    program->enableAttributeArray(vertexLocation);
-    program->setAttributeBuffer(vertexLocation, GL_FLOAT, offset, 3, sizeof(VertexData));
+// The slides are kept compressed on the GPU when asked for and
+// supported: 4 (RGB565) to 8 (RGBA) times less upload bandwidth
+// and video memory. Otherwise they stay in the slide format.
+// Must be called with the OpenGL context current.
+void
+SlideWidget::chooseCompression() {
+    compression = TextureCompressor::NoCompression;
+    if(bTextureCompression) {
+        compression = TextureCompressor::supportedFormat(QOpenGLContext::currentContext());
+        if(compression == TextureCompressor::NoCompression) {
+            logMessage(pLogFile,
+                       Q_FUNC_INFO,
+                       QString("No compressed texture format available: slides left uncompressed"));
+        }
+    }
+    pPrefetcher->setCompression(compression);
+    if(bSlideCache)
+        pSlideCache->update(slideList, panelSize, bGpuLetterbox, compression,
+                            slideFormats[iSlideFormat].imageFormat);
+#ifdef LOG_MESG
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("Slide textures: %1").arg(TextureCompressor::formatName(compression)));
+#endif
+}
+
 
-    // Offset for texture coordinate
-    offset += sizeof(QVector3D);
+void
+SlideWidget::setTextureCompression(bool bEnable) {
+    if(bEnable == bTextureCompression)
+        return;
+    bTextureCompression = bEnable;
+    if(!context()) // Applied when OpenGL will be initialized
+        return;
+    makeCurrent();
+    chooseCompression();
+    doneCurrent();
+}
 
-    // Tell OpenGL programmable pipeline how to locate vertex texture coordinate data
-    int texcoordLocation = program->attributeLocation("a_texcoord");
-    program->enableAttributeArray(texcoordLocation);
-    program->setAttributeBuffer(texcoordLocation, GL_FLOAT, offset, 2, sizeof(VertexData));
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, nVertices);
+// With a memory budget (in MB) the slide format and the number of
+// slides prefetched are chosen to stay within it. The budget is
+// applied when the slide textures are allocated.
+void
+SlideWidget::setMemoryBudget(int mbBudget) {
+    mbMemoryBudget = qMax(mbBudget, 0);
 }
 
 
+// Estimates, for each format, the peak memory taken by the slides:
+// the texture pool, the Pixel Buffer, the prefetched slides, the slide
+// waiting for upload and the one being composed (always RGBA).
 void
-SlideWidget::initializeGL() {
-    initializeOpenGLFunctions();
-    glClearColor(1, 1, 1, 1);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+SlideWidget::chooseSlideFormat() {
+    qint64 nPixels = qint64(panelSize.width()) * panelSize.height();
+    int nFormats = int(sizeof(slideFormats)/sizeof(slideFormats[0]));
+    iSlideFormat = 0;
+    int iDepth = PREFETCH_DEPTH;
+    if(mbMemoryBudget > 0) {
+        qint64 budget = qint64(mbMemoryBudget) * MEGABYTE;
+        bool bFound = false;
+        for(int iFormat=0; (iFormat<nFormats) && !bFound; iFormat++) {
+            qint64 slideBytes = nPixels * slideFormats[iFormat].nBytesPerPixel;
+            for(iDepth=PREFETCH_DEPTH; iDepth>0; iDepth--) {
+                qint64 needed = (TEXTURE_POOL_SIZE + 1 + iDepth + 1) * slideBytes + nPixels*4;
+                if(needed <= budget) {
+                    iSlideFormat = iFormat;
+                    bFound = true;
+                    break;
+                }
+            }
+        }
+        if(!bFound) {
+            iSlideFormat = nFormats - 1;
+            iDepth = 1;
+            logMessage(pLogFile,
+                       Q_FUNC_INFO,
+                       QString("Memory budget of %1 MB too small: using the minimum")
+                       .arg(mbMemoryBudget));
+        }
+    }
+    pPrefetcher->setImageFormat(slideFormats[iSlideFormat].imageFormat);
+    pPrefetcher->setQueueDepth(iDepth);
+#ifdef LOG_MESG
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("Slides as %1, %2 prefetched")
+               .arg(slideFormats[iSlideFormat].sName)
+               .arg(iDepth));
+#endif
+}
 
-    initShaders();
-    initTextures();
-    initGeometry();
 
-    if((currentAnimation >= pPrograms.count()) ||
-       (currentAnimation < 0))
-        currentAnimation = 0;
-    pCurrentProgram = pPrograms.at(currentAnimation);
-    if(!pCurrentProgram->bind()) {
-        qCritical() << __FUNCTION__ << __LINE__;
-        close();
-        return;
+// Memory now taken by the slides (textures included)
+qint64
+SlideWidget::memoryFootprint() const {
+    qint64 nBytes = 0;
+    for(int i=0; i<texturePool.count(); i++) {
+        QOpenGLTexture* pTexture = texturePool.at(i);
+        if(pTexture->format() == slideFormats[iSlideFormat].textureFormat)
+            nBytes += qint64(pTexture->width()) * pTexture->height() *
+                      slideFormats[iSlideFormat].nBytesPerPixel;
+        else
+            nBytes += TextureCompressor::compressedSize(QSize(pTexture->width(), pTexture->height()));
     }
-    getLocations();
+    if(pixelBuf.isCreated()) // Without asking OpenGL: the context may be not current
+        nBytes += qint64(panelSize.width()) * panelSize.height() *
+                  slideFormats[iSlideFormat].nBytesPerPixel;
+    nBytes += nextSlide.sizeInBytes();
+    nBytes += nextCompressed.blocks.size();
+    nBytes += pPrefetcher->queuedBytes();
+    return nBytes;
 }
 
 
+// Returns a pool texture not in use by the current transition
+QOpenGLTexture*
+SlideWidget::freeTexture() {
+    for(int i=0; i<texturePool.count(); i++) {
+        QOpenGLTexture* pTexture = texturePool.at(i);
+        if((pTexture != pTexture0) && (pTexture != pTexture1))
+            return pTexture;
+    }
+    return nullptr;
+}
+
+
+// Refill the texture storage with glTexSubImage2D()
+// Must be called with the OpenGL context current.
 void
-SlideWidget::initShaders() {
-    QStringList fShaderList = QStringList({
-#ifndef RPI3
-                                          "fFilmBurn",
-                                          "fDoomScreen",
-                                          "fPolkaDotsCurtain",
-                                          "fSwap",
-#endif
-                                          "fBookFlip",
-                                          "fAngular",
-                                          "fBounce",
-                                          "fWaterDrop",
-                                          "fFlyEye",
-                                          "fMorph",
-                                          "fPerlin",
-                                          "fPinwheel",
-                                          "fPowerKaleido",
-                                          "fInvertedPageCurl",
-                                          "fDisplacement",
-                                          "fSwirl",
-                                          "fDreamy",
-                                          "fCrosshatch",
-                                          "fRadial",
-                                          "fRipple",
-                                          "fCircleopen",
-                                          "fFade",
-                                          "fMultiply_blend",
-                                          "fPixelize",
-                                          "fWind",
-                                          "fCrosswarp"
-    });
-    for(int i=0; i<fShaderList.count(); i++) {
-        QString sBaseDir;
-#ifdef __ARM_ARCH
-    #ifdef RPI3
-        sBaseDir = "/CommonFiles/ShadersRPi3";
-    #else
-        sBaseDir = "/CommonFiles/ShadersRPi4";
-    #endif
-#else
-        sBaseDir = "/CommonFiles/Shaders";
+SlideWidget::uploadSlide(QOpenGLTexture* pTexture, const QImage& slide) {
+    QElapsedTimer uploadTime;
+    uploadTime.start();
+    const SlideFormat& slideFormat = slideFormats[iSlideFormat];
+    if(pTexture->format() != slideFormat.textureFormat) // It held a compressed slide
+        allocateSlideTexture(pTexture);
+    QImage glImage = slide;
+    QSize textureSize(pTexture->width(), pTexture->height());
+    if(bGpuLetterbox) { // The slide must fit into the texture
+        if((glImage.width() > textureSize.width()) || (glImage.height() > textureSize.height()))
+            glImage = glImage.scaled(textureSize, Qt::KeepAspectRatio);
+    }
+    else if(glImage.size() != textureSize)
+        glImage = glImage.scaled(textureSize);
+    if(glImage.format() != slideFormat.imageFormat)
+        glImage = SlidePrefetcher::convertSlide(glImage, slideFormat.imageFormat);
+    pTexture->bind();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    bool bUsePbo = bPboUpload && bPboSupported &&
+                   (glImage.sizeInBytes() <= pixelBuf.size());
+    if(bUsePbo)
+        bUsePbo = uploadSlideAsync(glImage);
+    if(!bUsePbo) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                        glImage.width(), glImage.height(),
+                        GLenum(slideFormat.pixelFormat), GLenum(slideFormat.pixelType),
+                        glImage.constBits());
+    }
+    pTexture->release();
+    slideTransitions.placeSlide(pTexture, glImage.size());
+#ifdef LOG_VERBOSE
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("%1 upload: %2 us")
+               .arg(bUsePbo ? "PBO" : "Sync")
+               .arg(uploadTime.nsecsElapsed()/1000));
 #endif
+}
 
-        QOpenGLShaderProgram* pNewProgram = new QOpenGLShaderProgram(this);
-        if (!pNewProgram->addShaderFromSourceFile(QOpenGLShader::Vertex, QString(":%1/vShader.glsl").arg(sBaseDir))) {
-            close();
-            return;
-        }
-        QString sFshader = QString(":%1/%2.glsl").arg(sBaseDir).arg(fShaderList.at(i));
-        if (!pNewProgram->addShaderFromSourceFile(QOpenGLShader::Fragment, sFshader)) {
-            qDebug() << sFshader;
-            close();
-            return;
-        }
-        if (!pNewProgram->link()) {
-            qDebug() << sFshader;
-            close();
-            return;
-        }
-        pNewProgram->setObjectName(fShaderList.at(i));
-        pPrograms.append(pNewProgram);
+
+QOpenGLTexture::TextureFormat
+SlideWidget::compressedFormat(TextureCompressor::Format format) {
+    switch(format) {
+    case TextureCompressor::Bc1:  return QOpenGLTexture::RGB_DXT1;
+    case TextureCompressor::Etc1: return QOpenGLTexture::RGB8_ETC1;
+    case TextureCompressor::Etc2: return QOpenGLTexture::RGB8_ETC2;
+    default:                      return QOpenGLTexture::NoFormat;
     }
+}
+
 
-    nAnimationTypes = pPrograms.count();
-    currentAnimation = rand() % nAnimationTypes;
+// The compressed texture gets the size of the slide: the storage is
+// mutable and respecified with glCompressedTexImage2D() at every
+// upload (ETC1 on OpenGL ES 2.0 has no sub image update).
+// Must be called with the OpenGL context current.
+void
+SlideWidget::uploadCompressedSlide(QOpenGLTexture* pTexture, const CompressedImage& slide) {
+    QElapsedTimer uploadTime;
+    uploadTime.start();
+    QOpenGLTexture::TextureFormat textureFormat = compressedFormat(slide.format);
+    if((pTexture->format() != textureFormat) ||
+       (pTexture->width()  != slide.size.width()) ||
+       (pTexture->height() != slide.size.height()))
+    {
+        pTexture->destroy();
+        pTexture->setFormat(textureFormat);
+        pTexture->setSize(slide.size.width(), slide.size.height());
+        pTexture->setMipLevels(1);
+        pTexture->create();
+        pTexture->setMinificationFilter(QOpenGLTexture::Nearest);
+        pTexture->setMagnificationFilter(QOpenGLTexture::Linear);
+        pTexture->setWrapMode(QOpenGLTexture::Repeat);
+    }
+    pTexture->bind();
+    glCompressedTexImage2D(GL_TEXTURE_2D, 0, GLenum(textureFormat),
+                           slide.size.width(), slide.size.height(), 0,
+                           GLsizei(slide.blocks.size()), slide.blocks.constData());
+    pTexture->release();
+    slideTransitions.placeSlide(pTexture, slide.size);
+#ifdef LOG_VERBOSE
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("%1 upload: %2 us")
+               .arg(TextureCompressor::formatName(slide.format))
+               .arg(uploadTime.nsecsElapsed()/1000));
+#endif
 }
 
 
-// Called just once in SlideWidget::initializeGL()
+// The slide taken from the prefetcher, compressed or not
 void
-SlideWidget::initTextures() {
-    // The very first texture is a screenshot of the panel
-    // captured from SlideWidget::showFullScreen()
-    // Now we get the second texture
-    if(!prepareNextSlide()) {
-        close();
-        return;
+SlideWidget::uploadNextSlide(QOpenGLTexture* pTexture) {
+    if(!nextCompressed.isNull())
+        uploadCompressedSlide(pTexture, nextCompressed);
+    else
+        uploadSlide(pTexture, nextSlide);
+    nextSlide = QImage(); // Now it lives in the texture
+    nextCompressed = CompressedImage();
+}
+
+
+// Copies the slide into the (orphaned) Pixel Buffer Object and
+// issues the texture update from it: the CPU->GPU transfer is then
+// done by the driver while we keep rendering. The texture is sampled
+// only at the next transition, a whole STEADY_SHOW_TIME later.
+// Must be called with the destination texture bound.
+bool
+SlideWidget::uploadSlideAsync(const QImage& glImage) {
+    pixelBuf.bind();
+    void* pData = pixelBuf.mapRange(0, int(glImage.sizeInBytes()),
+                                    QOpenGLBuffer::RangeWrite |
+                                    QOpenGLBuffer::RangeInvalidateBuffer);
+    if(!pData) // OpenGL 2.1 has no glMapBufferRange()
+        pData = pixelBuf.map(QOpenGLBuffer::WriteOnly);
+    if(!pData) {
+        pixelBuf.release();
+        return false;
+    }
+    memcpy(pData, glImage.constBits(), size_t(glImage.sizeInBytes()));
+    if(!pixelBuf.unmap()) { // The buffer content got corrupted
+        pixelBuf.release();
+        return false;
     }
-    pTexture1 = new QOpenGLTexture(*pBaseImage);
-    pTexture1->setMinificationFilter(QOpenGLTexture::Nearest);
-    pTexture1->setMagnificationFilter(QOpenGLTexture::Linear);
-    pTexture1->setWrapMode(QOpenGLTexture::Repeat);
-}
-
-
-void
-SlideWidget::initGeometry() {
-    QVector<VertexData> vertices;
-    int nxStep = 54;
-    int nyStep = 36;
-    float dx = 2.0/nxStep;
-    float dy = 2.0/nyStep;
-    float xdx, ydy;
-
-    float x, y, xT, yT;
-    x = -1.0;
-    for(int i=0; i<nxStep; i++) {
-        xdx = x + dx;
-        if(xdx >= 1.0f) xdx= 1.0f;
-        xT = x + 1.0;
-        y= -1.0f;
-        for(int j=0; j<nyStep; j++) {
-            ydy = y + dy;
-            if(ydy >= 1.0f) ydy = 1.0f;
-            yT = y + 1.0;
-            vertices.append({QVector3D(x,   y,        0.0f),
-                             QVector2D(0.5*xT,        0.5*yT)});
-            vertices.append({QVector3D(xdx, y,        0.0f),
-                             QVector2D(0.5*(xdx+1.0), 0.5*yT)});
-            vertices.append({QVector3D(x,   ydy,      0.0f),
-                             QVector2D(0.5*xT,        0.5*(ydy+1.0))});
-            vertices.append({QVector3D(xdx, ydy,      0.0f),
-                             QVector2D(0.5*(xdx+1.0), 0.5*(ydy+1.0))});
-            y = ydy;
+    const SlideFormat& slideFormat = slideFormats[iSlideFormat];
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                    glImage.width(), glImage.height(),
+                    GLenum(slideFormat.pixelFormat), GLenum(slideFormat.pixelType),
+                    nullptr); // Offset into the bound Pixel Buffer
+    pixelBuf.release();
+    return true;
+}
+
+
+// GPU timings are available only where the timer queries are
+// (not on OpenGL ES): elsewhere only the CPU side is measured.
+void
+SlideWidget::initTimerQueries() {
+#if !QT_CONFIG(opengles2)
+    for(int i=0; i<GPU_TIMER_QUERIES; i++) {
+        QOpenGLTimerQuery* pTimer = new QOpenGLTimerQuery();
+        if(!pTimer->create()) {
+            delete pTimer;
+            break;
         }
-        x = xdx;
+        gpuTimers.append(pTimer);
+        gpuTimerTransition.append(QString());
     }
-    nVertices = vertices.count();
-    // Transfer vertex data to VBO
-    arrayBuf.create();
-    arrayBuf.bind();
-    arrayBuf.allocate(vertices.data(), nVertices*sizeof(VertexData));
+#endif
+#ifdef LOG_MESG
+    if(gpuTimers.isEmpty())
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("GPU timer queries not available"));
+#endif
+}
+
+
+// The queries are used in rotation so that the result of a frame
+// is read when the GPU has already done it, without stalling.
+void
+SlideWidget::beginGpuTimer(const QString& sTransition) {
+#if !QT_CONFIG(opengles2)
+    if(gpuTimers.isEmpty())
+        return;
+    iGpuTimer = (iGpuTimer + 1) % gpuTimers.count();
+    QOpenGLTimerQuery* pTimer = gpuTimers.at(iGpuTimer);
+    if(!gpuTimerTransition.at(iGpuTimer).isEmpty() && pTimer->isResultAvailable())
+        frameStats.addGpuTime(gpuTimerTransition.at(iGpuTimer),
+                              double(pTimer->waitForResult())/1.0e6);
+    gpuTimerTransition[iGpuTimer] = sTransition;
+    pTimer->begin();
+#else
+    Q_UNUSED(sTransition)
+#endif
+}
+
+
+void
+SlideWidget::endGpuTimer() {
+#if !QT_CONFIG(opengles2)
+    if(!gpuTimers.isEmpty())
+        gpuTimers.at(iGpuTimer)->end();
+#endif
 }
 
 
 void
 SlideWidget::paintGL() {
+    QElapsedTimer cpuTime;
+    cpuTime.start();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LEQUAL);
 
     if(pTexture0 && pTexture1) {
-        pTexture0->bind(0);
-        pTexture1->bind(1);
-        pCurrentProgram->bind();
-        pCurrentProgram->setUniformValue(iTex0Loc, 0);
-        pCurrentProgram->setUniformValue(iTex1Loc, 1);
-        pCurrentProgram->setUniformValue(iProgressLoc, progress);
-        pCurrentProgram->setUniformValue("mvp_matrix", m);
-
-        drawGeometry(pCurrentProgram);
-        pTexture0->release();
-        pTexture1->release();
+        QString sTransition = slideTransitions.currentName();
+        if(bAnimating)
+            beginGpuTimer(sTransition);
+        slideTransitions.draw(pTexture0, pTexture1, progress);
+        if(bAnimating) {
+            endGpuTimer();
+            frameStats.addCpuTime(sTransition,
+                                  double(cpuTime.nsecsElapsed())/1.0e6);
+        }
     }
     glDisable(GL_DEPTH_TEST);
+    if(bScoreTicker)
+        scoreTicker.draw();
+    if(bStatsOverlay)
+        drawStatsOverlay();
+}
+
+
+// The statistics collected so far drawn over the slides
+void
+SlideWidget::drawStatsOverlay() {
+    QStringList lines = frameStats.report();
+    lines.append(QString("Slide memory: %1 MB (%2)")
+                 .arg(double(memoryFootprint())/MEGABYTE, 0, 'f', 1)
+                 .arg(slideFormats[iSlideFormat].sName));
+    QPainter painter(this);
+    QFont font("Monospace");
+    font.setStyleHint(QFont::TypeWriter);
+    font.setPixelSize(qMax(height()/60, 10));
+    painter.setFont(font);
+    QFontMetrics metrics(font);
+    int iLineHeight = metrics.lineSpacing();
+    int iWidth = 0;
+    for(const QString& sLine : lines)
+        iWidth = qMax(iWidth, metrics.horizontalAdvance(sLine));
+    QRect box(0, 0, iWidth+2*iLineHeight, int(lines.count()+1)*iLineHeight);
+    painter.fillRect(box, QColor(0, 0, 0, 160));
+    QString sCurrent = slideTransitions.currentName();
+    for(int i=0; i<lines.count(); i++) {
+        if(lines.at(i).startsWith(sCurrent + " "))
+            painter.setPen(Qt::yellow);
+        else
+            painter.setPen(Qt::white);
+        painter.drawText(iLineHeight, (i+1)*iLineHeight, lines.at(i));
+    }
+    painter.end();
+}
+
+
+// The score over the slides and the spots
+void
+SlideWidget::setScoreTicker(bool bEnable) {
+    bScoreTicker = bEnable;
+    update();
+}
+
+
+// The ticker follows the score panel: only a repaint is needed,
+// the GL resources are updated at the next frame.
+void
+SlideWidget::setTickerTeam(int iTeam, const QString& sTeam) {
+    scoreTicker.setTeam(iTeam, sTeam);
+    if(bScoreTicker)
+        update();
 }
 
 
 void
-SlideWidget::ontimerAnimateEvent() {
-    progress += 0.02f;
+SlideWidget::setTickerScore(int iTeam, int iScore) {
+    scoreTicker.setScore(iTeam, iScore);
+    if(bScoreTicker)
+        update();
+}
+
+
+// Show the transition timings on the screen
+void
+SlideWidget::setStatsOverlay(bool bEnable) {
+    bStatsOverlay = bEnable;
+    update();
+}
+
+
+const TransitionStats&
+SlideWidget::transitionStats() const {
+    return frameStats;
+}
+
+
+void
+SlideWidget::logTransitionStats() {
+    const QStringList lines = frameStats.report();
+    for(const QString& sLine : lines)
+        logMessage(pLogFile, Q_FUNC_INFO, sLine);
+}
+
+
+void
+SlideWidget::setTransitionDuration(int msDuration) {
+    msTransitionTime = qMax(msDuration, 1);
+}
+
+
+// Number of frames the display refreshed without
+// a new image during the last transition
+int
+SlideWidget::droppedFrames() const {
+    return nDroppedFrames;
+}
+
+
+void
+SlideWidget::startTransition() {
+    progress          = 0.0f;
+    nTransitionFrames = 0;
+    nDroppedFrames    = 0;
+    bAnimating        = true;
+    frameStats.addRun(slideTransitions.currentName());
+    transitionTime.start();
+    lastSwapTime.start();
+    update();
+}
+
+
+// Progress depends only on the time elapsed since the transition start:
+// if a frame is missed the animation skips ahead instead of slowing down.
+void
+SlideWidget::onFrameSwapped() {
+    if(!bAnimating)
+        return;
+    qint64 nsFrame = lastSwapTime.nsecsElapsed();
+    lastSwapTime.start();
+    if(nTransitionFrames > 0) {
+        qreal refreshRate = pMyScreen->refreshRate();
+        if(refreshRate <= 0.0) refreshRate = 60.0;
+        qreal nsRefresh = 1.0e9 / refreshRate;
+        int nMissed = qMax(qRound(nsFrame/nsRefresh) - 1, 0);
+        nDroppedFrames += nMissed;
+        frameStats.addSwap(slideTransitions.currentName(), double(nsFrame)/1.0e6, nMissed);
+    }
+    nTransitionFrames++;
+
+    progress = GLfloat(transitionTime.elapsed()) / GLfloat(msTransitionTime);
     if(progress >= 1.0f) {
-        timerAnimate.stop();
-        prepareNextRound();
+        bAnimating = false;
+#ifdef LOG_MESG
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("%1: %2 frames, %3 dropped")
+                   .arg(slideTransitions.currentName())
+                   .arg(nTransitionFrames)
+                   .arg(nDroppedFrames));
+#endif
+        slideTransitions.transitionDone(nTransitionFrames,
+                                        nDroppedFrames,
+                                        double(transitionTime.elapsed()));
+        if(bShowingSpots)
+            endSpotTransition();
+        else
+            prepareNextRound();
         progress = 0.0f;
     }
 
@@ -503,6 +1147,15 @@ SlideWidget::ontimerAnimateEvent() {
 
 void
 SlideWidget::onTimerSteadyEvent() {
-    timerAnimate.start(UPDATE_TIME);
+    if(!bNextSlideReady) {
+        makeCurrent();
+        takeNextSlide();
+        doneCurrent();
+        if(!bNextSlideReady) { // Still in the works
+            timerSteady.start(PREFETCH_RETRY_TIME);
+            return;
+        }
+    }
+    startTransition();
 }
 
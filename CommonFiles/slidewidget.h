@@ -29,71 +29,154 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QOpenGLBuffer>
 #include <QFileInfoList>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileSystemWatcher>
 
+#include "transitionstats.h"
+#include "slidetransitions.h"
+#include "scoreticker.h"
+#include "texturecompressor.h"
+
+
+QT_FORWARD_DECLARE_CLASS(SlidePrefetcher)
+QT_FORWARD_DECLARE_CLASS(SlideCache)
+QT_FORWARD_DECLARE_CLASS(SpotPlayer)
+QT_FORWARD_DECLARE_CLASS(QOpenGLTimerQuery)
 
 class SlideWidget : public QOpenGLWidget, protected QOpenGLFunctions
 {
     Q_OBJECT
 
 public:
-    SlideWidget();
+    SlideWidget(QFile *myLogFile = nullptr);
     ~SlideWidget();
 
 public:
     bool setSlideDir(QString sNewDir);
+    void setPboUpload(bool bEnable);
+    void setGpuLetterbox(bool bEnable);
+    void setSlideCache(bool bEnable);
+    void setTextureCompression(bool bEnable);
     bool startSlideShow();
     void stopSlideShow();
+    bool startSpotShow(const QFileInfoList& spots, int iFirstSpot);
+    void stopSpotShow();
+    int  currentSpot() const;
+    void setTransitionDuration(int msDuration);
+    int  droppedFrames() const;
+    void setStatsOverlay(bool bEnable);
+    void setMemoryBudget(int mbBudget);
+    void setScoreTicker(bool bEnable);
+    void setTickerTeam(int iTeam, const QString& sTeam);
+    void setTickerScore(int iTeam, int iScore);
+    void setScorePanel(QWidget* pPanel);
+    qint64 memoryFootprint() const;
+    const TransitionStats& transitionStats() const;
+    void logTransitionStats();
     void showFullScreen();
 
 protected:
     void initializeGL() override;
     void paintGL() override;
 
-    void initShaders();
     void initTextures();
-    bool getLocations();
+    void initTexturePool();
+    void allocateSlideTexture(QOpenGLTexture* pTexture);
+    QOpenGLTexture* freeTexture();
+    void uploadSlide(QOpenGLTexture* pTexture, const QImage& slide);
+    void uploadCompressedSlide(QOpenGLTexture* pTexture, const CompressedImage& slide);
+    void uploadNextSlide(QOpenGLTexture* pTexture);
+    bool uploadSlideAsync(const QImage& glImage);
 
     bool prepareNextRound() ;
     bool prepareNextSlide();
+    bool takeNextSlide();
 
 public slots:
-    void ontimerAnimateEvent();
+    void onFrameSwapped();
     void onTimerSteadyEvent();
+    void onTimerPrewarmEvent();
+    void onSlideDirChanged();
+    void onVideoFrameReady();
+    void onTimerRescanEvent();
     void closeEvent(QCloseEvent*) override;
 
 private:
-    void initGeometry();
-    void drawGeometry(QOpenGLShaderProgram *program);
+    struct SlideFormat {
+        QImage::Format               imageFormat;
+        QOpenGLTexture::TextureFormat textureFormat;
+        QOpenGLTexture::PixelFormat  pixelFormat;
+        QOpenGLTexture::PixelType    pixelType;
+        int                          nBytesPerPixel;
+        const char*                  sName;
+    };
+
+private:
+    void startTransition();
     bool updateSlideList();
+    QFileInfoList scanSlideDir();
+    void watchSlideDir();
     void cleanOpenGL();
+    void initTimerQueries();
+    void beginGpuTimer(const QString& sTransition);
+    void endGpuTimer();
+    void drawStatsOverlay();
+    void chooseSlideFormat();
+    void chooseCompression();
+    static QOpenGLTexture::TextureFormat compressedFormat(TextureCompressor::Format format);
+    void startSpotTransition();
+    void endSpotTransition();
 
 private:
-    struct VertexData {
-        QVector3D position;
-        QVector2D texCoord;
-    };
-    QTimer timerAnimate;
+    QFile* pLogFile;
+    QElapsedTimer transitionTime;
+    QElapsedTimer lastSwapTime;
     QTimer timerSteady;
-    QVector<QOpenGLShaderProgram*> pPrograms;
-    QOpenGLShaderProgram* pCurrentProgram;
+    QTimer timerPrewarm;
+    QTimer timerRescan;
+    QFileSystemWatcher slideDirWatcher;
 
-    QOpenGLBuffer arrayBuf;
+    QOpenGLBuffer pixelBuf;
+    bool bPboSupported;
+    bool bPboUpload;
     QOpenGLTexture* pTexture0 = nullptr;
     QOpenGLTexture* pTexture1 = nullptr;
+    QVector<QOpenGLTexture*> texturePool;
 
     QString sSlideDir;
     int iCurrentSlide;
     QFileInfoList slideList;
-    int nVertices;
-    int nAnimationTypes;
     bool bRunning;
-    QImage* pBaseImage;
-    QImage image;
-    int currentAnimation;
-    GLint     iTex0Loc;
-    GLint     iTex1Loc;
-    QMatrix4x4 m;
-    GLint     iProgressLoc;
+    bool bAnimating;
+    bool bNextSlideReady;
+    int  msTransitionTime;
+    int  nTransitionFrames;
+    int  nDroppedFrames;
+    QSize panelSize;
+    QImage nextSlide;
+    CompressedImage nextCompressed;
+    bool bGpuLetterbox;
+    SlidePrefetcher* pPrefetcher;
+    bool bSlideCache;
+    SlideCache* pSlideCache;
     GLfloat   progress;
     QScreen*  pMyScreen;
+    QWidget*  pScorePanel = nullptr;
+    SpotPlayer* pSpotPlayer;
+    bool bShowingSpots;
+    QOpenGLTexture* pVideoTexture = nullptr;
+    TransitionStats frameStats;
+    QVector<QOpenGLTimerQuery*> gpuTimers;
+    QStringList gpuTimerTransition;
+    int  iGpuTimer;
+    bool bStatsOverlay;
+    int  mbMemoryBudget;
+    int  iSlideFormat;
+    SlideTransitions slideTransitions;
+    ScoreTicker scoreTicker;
+    bool bScoreTicker;
+    bool bTextureCompression;
+    TextureCompressor::Format compression;
+    static const SlideFormat slideFormats[];
 };
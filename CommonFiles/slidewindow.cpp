@@ -0,0 +1,187 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "slidewindow.h"
+#include "sliderenderer.h"
+#include "slideprefetcher.h"
+#include "utility.h"
+
+#include <QGuiApplication>
+#include <QOpenGLContext>
+#include <QScreen>
+#include <QWidget>
+#include <QDir>
+#include <QStandardPaths>
+
+
+SlideWindow::SlideWindow(QFile* myLogFile)
+    : QWindow()
+    , pLogFile(myLogFile)
+    , pScorePanel(nullptr)
+    , pPrefetcher(new SlidePrefetcher(this))
+    , pRenderer(nullptr)
+    , bGpuLetterbox(false)
+    , bInitialized(false)
+{
+    setSurfaceType(QWindow::OpenGLSurface);
+    setCursor(Qt::BlankCursor);
+
+    QList<QScreen*> screens = QGuiApplication::screens();
+    pMyScreen = screens.at(0);
+    if(screens.count() > 1)
+        pMyScreen = screens.at(1);
+    setScreen(pMyScreen);
+    setGeometry(pMyScreen->geometry());
+    panelSize = pMyScreen->geometry().size();
+
+    if(!QOpenGLContext::supportsThreadedOpenGL()) {
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Threaded OpenGL not supported by this platform"));
+    }
+    sSlideDir = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation);
+    pPrefetcher->setPanelSize(panelSize);
+    pPrefetcher->start(QThread::LowPriority);
+
+    pRenderer = new SlideRenderer(myLogFile, pPrefetcher);
+    pRenderer->moveToThread(&renderThread);
+    renderThread.setObjectName("SlideRenderer");
+    renderThread.start(QThread::HighPriority);
+}
+
+
+SlideWindow::~SlideWindow() {
+    QMetaObject::invokeMethod(pRenderer, "shutdown", Qt::BlockingQueuedConnection);
+    renderThread.quit();
+    renderThread.wait();
+    delete pRenderer;
+    pPrefetcher->stopPrefetch();
+    pPrefetcher->wait();
+}
+
+
+QFileInfoList
+SlideWindow::scanSlideDir() {
+    QDir slideDir(sSlideDir);
+    if(!slideDir.exists())
+        return QFileInfoList();
+    QStringList nameFilter = QStringList() << "*.jpg" << "*.jpeg" << "*.png";
+    slideDir.setNameFilters(nameFilter);
+    slideDir.setFilter(QDir::Files);
+    return slideDir.entryInfoList();
+}
+
+
+bool
+SlideWindow::setSlideDir(QString sNewDir) {
+    sSlideDir = sNewDir;
+    QFileInfoList slideList = scanSlideDir();
+    if(slideList.isEmpty()) {
+        pPrefetcher->setSlideList(QFileInfoList({QFileInfo(":/CommonFiles/Loghi/Logo_UniMe.png")}), 0);
+        return false;
+    }
+    pPrefetcher->setSlideList(slideList, 0);
+    return true;
+}
+
+
+void
+SlideWindow::setGpuLetterbox(bool bEnable) {
+    bGpuLetterbox = bEnable;
+    pPrefetcher->setGpuLetterbox(bEnable);
+    QMetaObject::invokeMethod(pRenderer, "setGpuLetterbox",
+                              Qt::QueuedConnection, Q_ARG(bool, bEnable));
+}
+
+
+void
+SlideWindow::setSlideCache(bool bEnable) {
+    pPrefetcher->setSlideCache(bEnable);
+}
+
+
+void
+SlideWindow::setTransitionDuration(int msDuration) {
+    QMetaObject::invokeMethod(pRenderer, "setTransitionDuration",
+                              Qt::QueuedConnection, Q_ARG(int, msDuration));
+}
+
+
+// The widget shown before the Slide Show: it will be
+// the starting image of the first transition.
+void
+SlideWindow::setScorePanel(QWidget* pPanel) {
+    pScorePanel = pPanel;
+}
+
+
+// The panel can be grabbed only in the GUI thread:
+// the renderer gets just the composed image.
+void
+SlideWindow::showFullScreen() {
+    QImage image;
+    if(pScorePanel && pScorePanel->isVisible())
+        image = pScorePanel->grab().toImage();
+    else
+        image = pMyScreen->grabWindow(0).toImage();
+    image = SlidePrefetcher::composeImage(image, panelSize, bGpuLetterbox);
+    QWindow::showFullScreen();
+    if(!bInitialized) {
+        QMetaObject::invokeMethod(pRenderer, "initialize", Qt::QueuedConnection,
+                                  Q_ARG(QWindow*, this),
+                                  Q_ARG(double, pMyScreen->refreshRate()),
+                                  Q_ARG(QSize, panelSize));
+        bInitialized = true;
+    }
+    QMetaObject::invokeMethod(pRenderer, "showImage",
+                              Qt::QueuedConnection, Q_ARG(QImage, image));
+}
+
+
+bool
+SlideWindow::startSlideShow() {
+    if(!bInitialized)
+        return false;
+    QMetaObject::invokeMethod(pRenderer, "startShow", Qt::QueuedConnection);
+    return true;
+}
+
+
+// Blocking: the renderer must have stopped
+// using the textures when the window is hidden.
+void
+SlideWindow::stopSlideShow() {
+    QMetaObject::invokeMethod(pRenderer, "stopShow", Qt::BlockingQueuedConnection);
+}
+
+
+void
+SlideWindow::exposeEvent(QExposeEvent* event) {
+    Q_UNUSED(event)
+    if(isExposed())
+        QMetaObject::invokeMethod(pRenderer, "requestFrame", Qt::QueuedConnection);
+}
+
+
+void
+SlideWindow::resizeEvent(QResizeEvent* event) {
+    Q_UNUSED(event)
+    QSize viewportSize = size() * devicePixelRatio();
+    QMetaObject::invokeMethod(pRenderer, "setViewportSize",
+                              Qt::QueuedConnection, Q_ARG(QSize, viewportSize));
+}
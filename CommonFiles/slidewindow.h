@@ -0,0 +1,73 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QWindow>
+#include <QThread>
+#include <QFile>
+#include <QFileInfoList>
+
+
+QT_FORWARD_DECLARE_CLASS(QWidget)
+QT_FORWARD_DECLARE_CLASS(QScreen)
+QT_FORWARD_DECLARE_CLASS(SlidePrefetcher)
+QT_FORWARD_DECLARE_CLASS(SlideRenderer)
+
+
+// A Slide Show that does not share the GUI thread with the
+// controller: the frames are drawn and presented by a SlideRenderer
+// living in its own thread, the slides are prepared by the prefetcher.
+// The GUI thread only forwards the requests.
+class SlideWindow : public QWindow
+{
+    Q_OBJECT
+
+public:
+    explicit SlideWindow(QFile* myLogFile);
+    ~SlideWindow();
+
+public:
+    bool setSlideDir(QString sNewDir);
+    void setGpuLetterbox(bool bEnable);
+    void setSlideCache(bool bEnable);
+    void setTransitionDuration(int msDuration);
+    void setScorePanel(QWidget* pPanel);
+    void showFullScreen();
+    bool startSlideShow();
+    void stopSlideShow();
+
+protected:
+    void exposeEvent(QExposeEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+
+private:
+    QFileInfoList scanSlideDir();
+
+private:
+    QFile*           pLogFile;
+    QScreen*         pMyScreen;
+    QWidget*         pScorePanel;
+    SlidePrefetcher* pPrefetcher;
+    SlideRenderer*   pRenderer;
+    QThread          renderThread;
+    QString          sSlideDir;
+    QSize            panelSize;
+    bool             bGpuLetterbox;
+    bool             bInitialized;
+};
@@ -0,0 +1,377 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "spotindex.h"
+#include "utility.h"
+
+#include <QDir>
+#include <QHash>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QDateTime>
+
+
+#define SPOT_INDEX_FILE   ".spotindex"   // The sidecar, inside the spot directory
+#define SPOT_INDEX_HEADER "SpotIndex 2"  // First line of the sidecar
+#define RESCAN_DELAY      2000           // ms of quiet in the directory before a rescan
+
+
+SpotIndex::SpotIndex(QFile* myLogFile, QObject *parent)
+    : QObject(parent)
+    , pLogFile(myLogFile)
+#ifdef Q_OS_WINDOWS
+    , sProbe(QString("ffprobe.exe"))
+#else
+    , sProbe(QString("/usr/bin/ffprobe"))
+#endif
+    , bProbeAvailable(true)
+    , bIndexDirty(false)
+{
+    rescanTimer.setSingleShot(true);
+    connect(&rescanTimer, SIGNAL(timeout()),
+            this, SLOT(rescan()));
+    connect(&watcher, SIGNAL(directoryChanged(QString)),
+            this, SLOT(onDirectoryChanged(QString)));
+    connect(&probeProcess, SIGNAL(finished(int,QProcess::ExitStatus)),
+            this, SLOT(onProbeFinished(int,QProcess::ExitStatus)));
+    connect(&probeProcess, SIGNAL(errorOccurred(QProcess::ProcessError)),
+            this, SLOT(onProbeError(QProcess::ProcessError)));
+}
+
+
+SpotIndex::~SpotIndex() {
+    probeProcess.disconnect();
+    if(probeProcess.state() != QProcess::NotRunning)
+        probeProcess.kill();
+    if(bIndexDirty)
+        writeIndex(); // Keep what has been probed so far
+}
+
+
+// A new directory loads its sidecar, if any, before the scan:
+// the spots found there unchanged are not probed again.
+void
+SpotIndex::setDirectory(const QString& sNewDir) {
+    QString sDir = QDir(sNewDir).absolutePath();
+    if(sDir != sDirectory) {
+        if(bIndexDirty)
+            writeIndex();
+        if(!watcher.directories().isEmpty())
+            watcher.removePaths(watcher.directories());
+        probeQueue.clear();
+        sDirectory = sDir;
+        spotInfos.clear();
+        readIndex();
+        if(QDir(sDirectory).exists())
+            watcher.addPath(sDirectory);
+    }
+    rescan();
+}
+
+
+QString
+SpotIndex::directory() const {
+    return sDirectory;
+}
+
+
+// Built from the index only: no file system access
+QFileInfoList
+SpotIndex::spotList() const {
+    QFileInfoList list;
+    for(const SpotInfo& spot : spotInfos)
+        list.append(QFileInfo(sDirectory + QString("/") + spot.sFileName));
+    return list;
+}
+
+
+const QList<SpotInfo>&
+SpotIndex::spots() const {
+    return spotInfos;
+}
+
+
+// The spots not (yet) probed do not count
+qint64
+SpotIndex::totalDuration() const {
+    qint64 msTotal = 0;
+    for(const SpotInfo& spot : spotInfos) {
+        if(spot.msDuration > 0)
+            msTotal += spot.msDuration;
+    }
+    return msTotal;
+}
+
+
+QString
+SpotIndex::formatDuration(qint64 msDuration) {
+    qint64 iSeconds = (msDuration + 500) / 1000;
+    return QString("%1:%2")
+        .arg(iSeconds / 60)
+        .arg(iSeconds % 60, 2, 10, QChar('0'));
+}
+
+
+// Many changes come in a burst while a spot is being copied
+void
+SpotIndex::onDirectoryChanged(const QString& sPath) {
+    Q_UNUSED(sPath)
+    rescanTimer.start(RESCAN_DELAY);
+}
+
+
+// The spots with the same name, size and modification time keep
+// their metadata; the others are queued to be probed.
+void
+SpotIndex::rescan() {
+    rescanTimer.stop();
+    QFileInfoList fileList;
+    QDir spotDir(sDirectory);
+    if(!sDirectory.isEmpty() && spotDir.exists()) {
+        QStringList nameFilter(QStringList() << "*.mp4" << "*.MP4" << "*.mov" << "*.MOV");
+        spotDir.setNameFilters(nameFilter);
+        spotDir.setFilter(QDir::Files);
+        fileList = spotDir.entryInfoList();
+    }
+    QHash<QString, int> oldSpots;
+    for(int i=0; i<spotInfos.count(); i++)
+        oldSpots.insert(spotInfos.at(i).sFileName, i);
+
+    QList<SpotInfo> newInfos;
+    bool bChanged = (fileList.count() != spotInfos.count());
+    for(const QFileInfo& file : std::as_const(fileList)) {
+        SpotInfo spot;
+        spot.sFileName  = file.fileName();
+        spot.size       = file.size();
+        spot.msModified = file.lastModified().toMSecsSinceEpoch();
+        int iOld = oldSpots.value(spot.sFileName, -1);
+        if((iOld >= 0) &&
+           (spotInfos.at(iOld).size == spot.size) &&
+           (spotInfos.at(iOld).msModified == spot.msModified))
+        {
+            spot = spotInfos.at(iOld);
+        }
+        else
+            bChanged = true;
+        bChanged |= (iOld != newInfos.count()); // Order changed
+        newInfos.append(spot);
+    }
+    if(bChanged) {
+        spotInfos = newInfos;
+        bIndexDirty = true;
+#ifdef LOG_VERBOSE
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("%1 spots in %2").arg(spotInfos.count()).arg(sDirectory));
+#endif
+        emit indexChanged();
+    }
+    QString sDirPrefix = sDirectory + QString("/");
+    for(const SpotInfo& spot : std::as_const(spotInfos)) {
+        if((spot.msDuration < 0) &&
+           !probeQueue.contains(spot.sFileName) &&
+           (sProbingFile != sDirPrefix + spot.sFileName))
+        {
+            probeQueue.append(spot.sFileName);
+        }
+    }
+    probeNext();
+}
+
+
+// One ffprobe at a time: the sidecar is written
+// once the queue is empty.
+void
+SpotIndex::probeNext() {
+    if(probeProcess.state() != QProcess::NotRunning)
+        return;
+    if(!bProbeAvailable)
+        probeQueue.clear();
+    if(probeQueue.isEmpty()) {
+        if(bIndexDirty)
+            writeIndex();
+        return;
+    }
+    sProbingFile = sDirectory + QString("/") + probeQueue.takeFirst();
+    QStringList sArguments = QStringList{"-v", "error",
+                                         "-select_streams", "v:0",
+                                         "-show_entries", "format=duration:stream=codec_name,profile,level,pix_fmt,width,height",
+                                         "-of", "default=noprint_wrappers=1",
+                                         sProbingFile
+                                        };
+    probeProcess.start(sProbe, sArguments);
+}
+
+
+void
+SpotIndex::onProbeFinished(int exitCode, QProcess::ExitStatus exitStatus) {
+    QByteArray output = probeProcess.readAllStandardOutput();
+    QString sFile = sProbingFile;
+    sProbingFile.clear();
+    // The directory could have changed meanwhile
+    QString sDirPrefix = sDirectory + QString("/");
+    for(SpotInfo& spot : spotInfos) {
+        if(sDirPrefix + spot.sFileName != sFile)
+            continue;
+        if((exitStatus != QProcess::NormalExit) || (exitCode != 0) || !parseProbe(output, &spot)) {
+            logMessage(pLogFile,
+                       Q_FUNC_INFO,
+                       QString("Unable to probe %1").arg(sFile));
+            spot.msDuration = 0; // Not probed again until it changes
+        }
+#ifdef LOG_VERBOSE
+        else {
+            logMessage(pLogFile,
+                       Q_FUNC_INFO,
+                       QString("%1: %2 ms %3x%4 %5 %6@%7 %8")
+                       .arg(spot.sFileName)
+                       .arg(spot.msDuration)
+                       .arg(spot.resolution.width())
+                       .arg(spot.resolution.height())
+                       .arg(spot.sCodec, spot.sProfile)
+                       .arg(spot.iLevel)
+                       .arg(spot.sPixelFormat));
+        }
+#endif
+        bIndexDirty = true;
+        emit indexChanged();
+        break;
+    }
+    probeNext();
+}
+
+
+// After the other errors finished() is emitted as well
+void
+SpotIndex::onProbeError(QProcess::ProcessError error) {
+    if(error != QProcess::FailedToStart)
+        return;
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("%1 not available: the spots will not be probed").arg(sProbe));
+    bProbeAvailable = false;
+    sProbingFile.clear();
+    probeNext();
+}
+
+
+// The ffprobe output is made of "key=value" lines
+bool
+SpotIndex::parseProbe(const QByteArray& output, SpotInfo* pSpot) {
+    bool bDuration = false;
+    const QList<QByteArray> lines = output.split('\n');
+    for(const QByteArray& line : lines) {
+        int iEqual = line.indexOf('=');
+        if(iEqual < 0)
+            continue;
+        QByteArray key   = line.left(iEqual).trimmed();
+        QByteArray value = line.mid(iEqual+1).trimmed();
+        if(key == "codec_name")
+            pSpot->sCodec = QString::fromLatin1(value);
+        else if(key == "profile")
+            pSpot->sProfile = QString::fromLatin1(value);
+        else if(key == "level")
+            pSpot->iLevel = value.toInt();
+        else if(key == "pix_fmt")
+            pSpot->sPixelFormat = QString::fromLatin1(value);
+        else if(key == "width")
+            pSpot->resolution.setWidth(value.toInt());
+        else if(key == "height")
+            pSpot->resolution.setHeight(value.toInt());
+        else if(key == "duration") {
+            double seconds = value.toDouble(&bDuration); // "N/A" if unknown
+            if(bDuration)
+                pSpot->msDuration = qint64(seconds*1000.0 + 0.5);
+        }
+    }
+    return bDuration;
+}
+
+
+QString
+SpotIndex::indexFileName() const {
+    return sDirectory + QString("/") + QString(SPOT_INDEX_FILE);
+}
+
+
+// One tab separated line for each spot; the file name is the
+// last field. The order of the spots is the one of the directory.
+bool
+SpotIndex::readIndex() {
+    QFile file(indexFileName());
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+    QTextStream index(&file);
+    if(index.readLine() != QString(SPOT_INDEX_HEADER))
+        return false;
+    while(!index.atEnd()) {
+        QStringList fields = index.readLine().split('\t');
+        if(fields.count() < 10)
+            continue;
+        SpotInfo spot;
+        spot.size       = fields.at(0).toLongLong();
+        spot.msModified = fields.at(1).toLongLong();
+        spot.msDuration = fields.at(2).toLongLong();
+        spot.resolution = QSize(fields.at(3).toInt(), fields.at(4).toInt());
+        spot.sCodec       = fields.at(5);
+        spot.sProfile     = fields.at(6);
+        spot.iLevel       = fields.at(7).toInt();
+        spot.sPixelFormat = fields.at(8);
+        spot.sFileName    = fields.mid(9).join('\t');
+        spotInfos.append(spot);
+    }
+#ifdef LOG_VERBOSE
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("%1 spots read from %2").arg(spotInfos.count()).arg(indexFileName()));
+#endif
+    return true;
+}
+
+
+// The spot directory could be read only: the index
+// is then kept in memory only.
+bool
+SpotIndex::writeIndex() {
+    bIndexDirty = false;
+    if(sDirectory.isEmpty() || !QDir(sDirectory).exists())
+        return false;
+    QSaveFile file(indexFileName());
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to write %1").arg(indexFileName()));
+        return false;
+    }
+    QTextStream index(&file);
+    index << SPOT_INDEX_HEADER << "\n";
+    for(const SpotInfo& spot : std::as_const(spotInfos)) {
+        index << spot.size << "\t"
+              << spot.msModified << "\t"
+              << spot.msDuration << "\t"
+              << spot.resolution.width() << "\t"
+              << spot.resolution.height() << "\t"
+              << spot.sCodec << "\t"
+              << spot.sProfile << "\t"
+              << spot.iLevel << "\t"
+              << spot.sPixelFormat << "\t"
+              << spot.sFileName << "\n";
+    }
+    index.flush();
+    return file.commit();
+}
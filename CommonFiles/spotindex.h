@@ -0,0 +1,94 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QFile>
+#include <QFileInfoList>
+#include <QFileSystemWatcher>
+#include <QProcess>
+#include <QStringList>
+#include <QTimer>
+#include <QSize>
+
+
+// What the index knows about every spot. The duration is
+// negative until the spot has been probed.
+struct SpotInfo {
+    QString sFileName;
+    qint64  size       = 0;
+    qint64  msModified = 0;
+    qint64  msDuration = -1;
+    QSize   resolution;
+    QString sCodec;
+    QString sProfile;       // As named by ffprobe: "High", "Main", ...
+    int     iLevel     = 0; // Times 10: 41 is level 4.1
+    QString sPixelFormat;
+};
+
+
+// Keeps the list of the spots, with their metadata as given by
+// ffprobe, in a sidecar file inside the spot directory. A watcher
+// updates it when the directory changes: only the new or modified
+// spots are probed again, in background.
+class SpotIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SpotIndex(QFile* myLogFile = nullptr, QObject *parent = nullptr);
+    ~SpotIndex();
+
+public:
+    void setDirectory(const QString& sNewDir);
+    QString directory() const;
+    QFileInfoList spotList() const;
+    const QList<SpotInfo>& spots() const;
+    qint64 totalDuration() const;
+    static QString formatDuration(qint64 msDuration);
+
+signals:
+    void indexChanged();
+
+private slots:
+    void rescan();
+    void onDirectoryChanged(const QString& sPath);
+    void onProbeFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onProbeError(QProcess::ProcessError error);
+
+private:
+    QString indexFileName() const;
+    bool readIndex();
+    bool writeIndex();
+    void probeNext();
+    bool parseProbe(const QByteArray& output, SpotInfo* pSpot);
+
+private:
+    QFile*             pLogFile;
+    QString            sDirectory;
+    QList<SpotInfo>    spotInfos;
+    QFileSystemWatcher watcher;
+    QTimer             rescanTimer;
+    QProcess           probeProcess;
+    QString            sProbe;
+    QStringList        probeQueue;
+    QString            sProbingFile;
+    bool               bProbeAvailable;
+    bool               bIndexDirty;
+};
@@ -0,0 +1,246 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "spotplayer.h"
+#include "slideprefetcher.h"
+#include "utility.h"
+
+#include <QVideoSink>
+#include <QAudioOutput>
+#include <QMutexLocker>
+#include <QUrl>
+
+
+SpotPlayer::SpotPlayer(QFile* myLogFile, QObject *parent)
+    : QThread(parent)
+    , pLogFile(myLogFile)
+    , pPlayer(new QMediaPlayer(this))
+    , pVideoSink(new QVideoSink(this))
+    , pAudioOutput(new QAudioOutput(this))
+    , iCurrentSpot(0)
+    , nFailedSpots(0)
+    , bFramePending(false)
+    , bFrameReady(false)
+    , bFirstFrame(false)
+    , bReadyNewSpot(false)
+    , iGeneration(0)
+    , bGpuLetterbox(false)
+    , imageFormat(QImage::Format_RGBA8888_Premultiplied)
+    , bAbort(false)
+{
+    pPlayer->setVideoSink(pVideoSink);
+    pPlayer->setAudioOutput(pAudioOutput);
+    // The frames are taken in the thread delivering them
+    connect(pVideoSink, SIGNAL(videoFrameChanged(QVideoFrame)),
+            this, SLOT(onVideoFrameChanged(QVideoFrame)),
+            Qt::DirectConnection);
+    connect(pPlayer, SIGNAL(mediaStatusChanged(QMediaPlayer::MediaStatus)),
+            this, SLOT(onMediaStatusChanged(QMediaPlayer::MediaStatus)));
+    connect(pPlayer, SIGNAL(errorOccurred(QMediaPlayer::Error,QString)),
+            this, SLOT(onErrorOccurred(QMediaPlayer::Error,QString)));
+}
+
+
+SpotPlayer::~SpotPlayer() {
+    pPlayer->stop();
+    stopPlayer();
+    wait();
+}
+
+
+// Terminates the conversion thread
+void
+SpotPlayer::stopPlayer() {
+    QMutexLocker locker(&mutex);
+    bAbort = true;
+    frameArrived.wakeAll();
+}
+
+
+void
+SpotPlayer::setPanelSize(QSize newSize) {
+    QMutexLocker locker(&mutex);
+    panelSize = newSize;
+}
+
+
+void
+SpotPlayer::setGpuLetterbox(bool bEnable) {
+    QMutexLocker locker(&mutex);
+    bGpuLetterbox = bEnable;
+}
+
+
+void
+SpotPlayer::setImageFormat(QImage::Format newFormat) {
+    QMutexLocker locker(&mutex);
+    imageFormat = newFormat;
+}
+
+
+bool
+SpotPlayer::startSpots(const QFileInfoList& newList, int iFirstSpot) {
+    if(newList.isEmpty())
+        return false;
+    spotList = newList;
+    nFailedSpots = 0;
+    playSpot(iFirstSpot % spotList.count());
+    return true;
+}
+
+
+void
+SpotPlayer::stopSpots() {
+    pPlayer->stop();
+    QMutexLocker locker(&mutex);
+    iGeneration++; // Frames still in conversion are dropped
+    pendingFrame  = QVideoFrame();
+    readyFrame    = QImage();
+    bFramePending = false;
+    bFrameReady   = false;
+    bReadyNewSpot = false;
+}
+
+
+int
+SpotPlayer::currentSpot() const {
+    return iCurrentSpot;
+}
+
+
+void
+SpotPlayer::playSpot(int iSpot) {
+    iCurrentSpot = iSpot;
+    {
+        QMutexLocker locker(&mutex);
+        bFirstFrame = true; // It will start with a transition
+    }
+    pPlayer->setSource(QUrl::fromLocalFile(spotList.at(iSpot).absoluteFilePath()));
+    pPlayer->play();
+#ifdef LOG_VERBOSE
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("Now playing: %1")
+               .arg(spotList.at(iSpot).absoluteFilePath()));
+#endif
+}
+
+
+void
+SpotPlayer::playNextSpot() {
+    if(spotList.isEmpty())
+        return;
+    playSpot((iCurrentSpot + 1) % spotList.count());
+}
+
+
+void
+SpotPlayer::onMediaStatusChanged(QMediaPlayer::MediaStatus status) {
+    if(status == QMediaPlayer::EndOfMedia) {
+        nFailedSpots = 0;
+        playNextSpot();
+    }
+    else if(status == QMediaPlayer::InvalidMedia) {
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Invalid spot: %1")
+                   .arg(spotList.at(iCurrentSpot).absoluteFilePath()));
+        // Skip it, but do not loop forever if none can be played
+        if(++nFailedSpots >= spotList.count()) {
+            pPlayer->stop();
+            return;
+        }
+        playNextSpot();
+    }
+}
+
+
+void
+SpotPlayer::onErrorOccurred(QMediaPlayer::Error error, const QString& sError) {
+    Q_UNUSED(error)
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               sError);
+}
+
+
+// Called in the thread delivering the frames:
+// only the most recent frame is kept.
+void
+SpotPlayer::onVideoFrameChanged(const QVideoFrame& frame) {
+    if(!frame.isValid())
+        return;
+    QMutexLocker locker(&mutex);
+    pendingFrame  = frame;
+    bFramePending = true;
+    frameArrived.wakeOne();
+}
+
+
+// Returns the last converted frame, if any. pbNewSpot tells if
+// a new spot started since the previous call.
+bool
+SpotPlayer::takeFrame(QImage* pImage, bool* pbNewSpot) {
+    QMutexLocker locker(&mutex);
+    if(!bFrameReady)
+        return false;
+    *pImage = readyFrame;
+    readyFrame = QImage();
+    *pbNewSpot = bReadyNewSpot;
+    bFrameReady   = false;
+    bReadyNewSpot = false;
+    return true;
+}
+
+
+void
+SpotPlayer::run() {
+    forever {
+        mutex.lock();
+        while(!bAbort && !bFramePending)
+            frameArrived.wait(&mutex);
+        if(bAbort) {
+            mutex.unlock();
+            return;
+        }
+        QVideoFrame frame = pendingFrame;
+        pendingFrame  = QVideoFrame();
+        bFramePending = false;
+        bool bNewSpot = bFirstFrame;
+        bFirstFrame   = false;
+        QSize size = panelSize;
+        bool bLetterbox = bGpuLetterbox;
+        QImage::Format format = imageFormat;
+        int iMyGeneration = iGeneration;
+        mutex.unlock();
+
+        // YUV to RGB and composition for the panel
+        QImage image = SlidePrefetcher::convertSlide(
+            SlidePrefetcher::composeImage(frame.toImage(), size, bLetterbox),
+            format);
+
+        mutex.lock();
+        if(iMyGeneration == iGeneration) {
+            readyFrame = image;
+            bReadyNewSpot |= bNewSpot;
+            bFrameReady = true;
+        }
+        mutex.unlock();
+        emit frameReady();
+    }
+}
@@ -0,0 +1,93 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QImage>
+#include <QFileInfoList>
+#include <QSize>
+#include <QFile>
+#include <QMediaPlayer>
+#include <QVideoFrame>
+
+
+QT_FORWARD_DECLARE_CLASS(QVideoSink)
+QT_FORWARD_DECLARE_CLASS(QAudioOutput)
+
+
+// Plays the spots in process. The decoded frames are converted and
+// composed for the panel in a worker thread: SlideWidget only has to
+// upload the most recent one. Late frames are dropped.
+class SpotPlayer : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit SpotPlayer(QFile* myLogFile = nullptr, QObject *parent = nullptr);
+    ~SpotPlayer();
+
+public:
+    void setPanelSize(QSize newSize);
+    void setGpuLetterbox(bool bEnable);
+    void setImageFormat(QImage::Format newFormat);
+    bool startSpots(const QFileInfoList& newList, int iFirstSpot);
+    void stopSpots();
+    int  currentSpot() const;
+    bool takeFrame(QImage* pImage, bool* pbNewSpot);
+    void stopPlayer();
+
+signals:
+    void frameReady();
+
+protected:
+    void run() override;
+
+private slots:
+    void onVideoFrameChanged(const QVideoFrame& frame);
+    void onMediaStatusChanged(QMediaPlayer::MediaStatus status);
+    void onErrorOccurred(QMediaPlayer::Error error, const QString& sError);
+
+private:
+    void playSpot(int iSpot);
+    void playNextSpot();
+
+private:
+    QFile*         pLogFile;
+    QMediaPlayer*  pPlayer;
+    QVideoSink*    pVideoSink;
+    QAudioOutput*  pAudioOutput;
+    QFileInfoList  spotList;
+    int            iCurrentSpot;
+    int            nFailedSpots;
+    QMutex         mutex;
+    QWaitCondition frameArrived;
+    QVideoFrame    pendingFrame;
+    QImage         readyFrame;
+    bool           bFramePending;
+    bool           bFrameReady;
+    bool           bFirstFrame;
+    bool           bReadyNewSpot;
+    int            iGeneration;
+    QSize          panelSize;
+    bool           bGpuLetterbox;
+    QImage::Format imageFormat;
+    bool           bAbort;
+};
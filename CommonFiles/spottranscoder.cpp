@@ -0,0 +1,371 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "spottranscoder.h"
+#include "utility.h"
+
+#include <QDir>
+#include <QSet>
+#include <QThread>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+
+#define TRANSCODE_PROFILE "high"      // H.264 profile decoded in hardware by every panel
+#define TRANSCODE_LEVEL   "4.1"       // H.264 level decoded in hardware by every panel
+#define MAX_LEVEL         41          // The same level, as given by ffprobe
+#define HASH_CHUNK        (1 << 20)   // Bytes read at a time while hashing a spot
+#define COMMAND_NOT_FOUND 127         // Exit code of nice when ffmpeg is missing
+
+
+SpotTranscoder::SpotTranscoder(QFile* myLogFile, QObject *parent)
+    : QObject(parent)
+    , pLogFile(myLogFile)
+#ifdef Q_OS_WINDOWS
+    , sFfmpeg(QString("ffmpeg.exe"))
+#else
+    , sFfmpeg(QString("/usr/bin/ffmpeg"))
+#endif
+    , iGeneration(0)
+    , nThreads(1)
+    , iNiceness(19)
+    , bBusy(false)
+    , bFfmpegAvailable(true)
+{
+    // The spots are read one at a time: the disk is shared with the player
+    hashPool.setMaxThreadCount(1);
+    connect(&transcodeProcess, SIGNAL(finished(int,QProcess::ExitStatus)),
+            this, SLOT(onTranscodeFinished(int,QProcess::ExitStatus)));
+    connect(&transcodeProcess, SIGNAL(errorOccurred(QProcess::ProcessError)),
+            this, SLOT(onTranscodeError(QProcess::ProcessError)));
+}
+
+
+// The partial conversion in progress is thrown away
+SpotTranscoder::~SpotTranscoder() {
+    iGeneration.fetchAndAddOrdered(1);
+    hashPool.clear();
+    hashPool.waitForDone();
+    transcodeProcess.disconnect();
+    if(transcodeProcess.state() != QProcess::NotRunning) {
+        transcodeProcess.kill();
+        transcodeProcess.waitForFinished(); // Already killed: it is quick
+        QFile::remove(sTranscodeTarget + QString(".part"));
+    }
+}
+
+
+QString
+SpotTranscoder::cacheDir() {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           QString("/spots");
+}
+
+
+// The conversion runs with at most nThreads threads and, but on
+// Windows, with the given niceness: the panel must stay smooth.
+void
+SpotTranscoder::setLimits(int nNewThreads, int iNewNiceness) {
+    nThreads  = qMax(nNewThreads, 1);
+    iNiceness = qBound(0, iNewNiceness, 19);
+}
+
+
+QString
+SpotTranscoder::spotKey(const QString& sSpot, const SpotInfo& spot) {
+    return QString("%1|%2|%3")
+        .arg(sSpot)
+        .arg(spot.size)
+        .arg(spot.msModified);
+}
+
+
+// The spots not yet probed are left alone: they will be
+// checked again when the index knows them. The hardware decoders
+// take H.264 Main or High up to level 4.1 in 8 bit 4:2:0 only.
+bool
+SpotTranscoder::needsTranscode(const SpotInfo& spot) const {
+    if(spot.msDuration <= 0)
+        return false;
+    if(spot.sCodec != QString("h264"))
+        return true;
+    if((spot.sProfile != QString("High")) && (spot.sProfile != QString("Main")))
+        return true;
+    if((spot.iLevel <= 0) || (spot.iLevel > MAX_LEVEL))
+        return true;
+    if(spot.sPixelFormat != QString("yuv420p"))
+        return true;
+    return (spot.resolution.width()  > panelSize.width()) ||
+           (spot.resolution.height() > panelSize.height());
+}
+
+
+QString
+SpotTranscoder::targetFileName(const QString& sHash) const {
+    return QString("%1/%2-%3x%4.mp4")
+        .arg(cacheDir(), sHash)
+        .arg(panelSize.width())
+        .arg(panelSize.height());
+}
+
+
+// Called whenever the spot index changes. Only the new or
+// modified spots are queued for the conversion.
+void
+SpotTranscoder::update(const QString& sDir, const QList<SpotInfo>& spots, QSize newPanelSize) {
+    if(newPanelSize != panelSize) {
+        panelSize = newPanelSize;
+        jobs.clear(); // The targets depend on the panel size
+        pendingSpots.clear();
+    }
+    QHash<QString, Job> newJobs;
+    for(const SpotInfo& spot : spots) {
+        if(!needsTranscode(spot))
+            continue;
+        QString sSpot = sDir + QString("/") + spot.sFileName;
+        QString sKey  = spotKey(sSpot, spot);
+        Job job = jobs.value(sSpot);
+        if(job.sKey != sKey) {
+            job = Job();
+            job.sKey = sKey;
+        }
+        newJobs.insert(sSpot, job);
+        if(!job.bReady && job.sTarget.isEmpty() &&
+           !pendingSpots.contains(sSpot) && (sSpot != sTranscoding))
+        {
+            pendingSpots.append(sSpot);
+        }
+    }
+    jobs = newJobs;
+    for(int i=pendingSpots.count()-1; i>=0; i--) {
+        if(!jobs.contains(pendingSpots.at(i)))
+            pendingSpots.removeAt(i);
+    }
+    processNext();
+}
+
+
+// The spots already converted take the place of the originals
+QFileInfoList
+SpotTranscoder::playableList(const QFileInfoList& spotList) const {
+    if(jobs.isEmpty())
+        return spotList;
+    QFileInfoList list;
+    for(const QFileInfo& spot : spotList) {
+        Job job = jobs.value(spot.absoluteFilePath());
+        list.append(job.bReady ? QFileInfo(job.sTarget) : spot);
+    }
+    return list;
+}
+
+
+// One spot at a time: first its content is hashed, then,
+// if not already in the cache, it is converted.
+void
+SpotTranscoder::processNext() {
+    while(!bBusy && bFfmpegAvailable && !pendingSpots.isEmpty()) {
+        QString sSpot = pendingSpots.takeFirst();
+        QString sKey  = jobs.value(sSpot).sKey;
+        QString sHash = hashes.value(sKey);
+        if(sHash.isEmpty()) {
+            hashSpot(sSpot, sKey);
+            return;
+        }
+        Job& job = jobs[sSpot];
+        job.sTarget = targetFileName(sHash);
+        if(QFile::exists(job.sTarget)) {
+            job.bReady = true;
+            continue;
+        }
+        startTranscode(sSpot, job.sTarget);
+    }
+    if(!bBusy && pendingSpots.isEmpty())
+        removeUnusedFiles();
+}
+
+
+// Hashing a big spot takes seconds: it is done
+// by a low priority thread.
+void
+SpotTranscoder::hashSpot(const QString& sSpot, const QString& sKey) {
+    bBusy = true;
+    int iMyGeneration = iGeneration.loadAcquire();
+    hashPool.start([this, sSpot, sKey, iMyGeneration]() {
+        QThread::currentThread()->setPriority(QThread::LowestPriority);
+        QString sHash;
+        QFile file(sSpot);
+        if(file.open(QIODevice::ReadOnly)) {
+            QCryptographicHash hash(QCryptographicHash::Sha1);
+            while(!file.atEnd()) {
+                if(iGeneration.loadAcquire() != iMyGeneration)
+                    return;
+                QByteArray chunk = file.read(HASH_CHUNK);
+                if(chunk.isEmpty())
+                    break;
+                hash.addData(chunk);
+            }
+            if(file.atEnd())
+                sHash = QString::fromLatin1(hash.result().toHex());
+        }
+        QMetaObject::invokeMethod(this, "onHashReady", Qt::QueuedConnection,
+                                  Q_ARG(QString, sSpot),
+                                  Q_ARG(QString, sKey),
+                                  Q_ARG(QString, sHash));
+    });
+}
+
+
+// The spot could have changed while it was being read
+void
+SpotTranscoder::onHashReady(QString sSpot, QString sKey, QString sHash) {
+    bBusy = false;
+    if(sHash.isEmpty()) {
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to read %1").arg(sSpot));
+    }
+    else {
+        hashes.insert(sKey, sHash);
+        if(jobs.value(sSpot).sKey == sKey)
+            pendingSpots.prepend(sSpot);
+    }
+    processNext();
+}
+
+
+// ffmpeg writes to a ".part" file renamed only at the end:
+// the spot loop never sees a partial conversion.
+void
+SpotTranscoder::startTranscode(const QString& sSpot, const QString& sTarget) {
+    if(!QDir().mkpath(cacheDir())) {
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to create %1").arg(cacheDir()));
+        return;
+    }
+    QString sScale = QString("scale=w='min(iw,%1)':h='min(ih,%2)'"
+                             ":force_original_aspect_ratio=decrease"
+                             ":force_divisible_by=2")
+                         .arg(panelSize.width())
+                         .arg(panelSize.height());
+    QStringList sArguments = QStringList{"-nostdin",
+                                         "-y",
+                                         "-v", "error",
+                                         "-threads", QString::number(nThreads),
+                                         "-i", sSpot,
+                                         "-vf", sScale,
+                                         "-c:v", "libx264",
+                                         "-profile:v", TRANSCODE_PROFILE,
+                                         "-level:v", TRANSCODE_LEVEL,
+                                         "-pix_fmt", "yuv420p",
+                                         "-threads", QString::number(nThreads),
+                                         "-c:a", "aac",
+                                         "-b:a", "128k",
+                                         "-movflags", "+faststart",
+                                         "-f", "mp4",
+                                         sTarget + QString(".part")
+                                        };
+    sTranscoding     = sSpot;
+    sTranscodeTarget = sTarget;
+    bBusy = true;
+    transcodeTime.start();
+#ifdef LOG_VERBOSE
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("Transcoding %1").arg(sSpot));
+#endif
+#ifdef Q_OS_WINDOWS
+    transcodeProcess.start(sFfmpeg, sArguments);
+#else
+    sArguments.prepend(sFfmpeg);
+    sArguments.prepend(QString::number(iNiceness));
+    sArguments.prepend(QString("-n"));
+    transcodeProcess.start(QString("/usr/bin/nice"), sArguments);
+#endif
+}
+
+
+void
+SpotTranscoder::onTranscodeFinished(int exitCode, QProcess::ExitStatus exitStatus) {
+    bBusy = false;
+    QString sPartial = sTranscodeTarget + QString(".part");
+    if((exitStatus == QProcess::NormalExit) && (exitCode == 0) &&
+       QFile::rename(sPartial, sTranscodeTarget))
+    {
+#ifdef LOG_MESG
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("%1 transcoded in %2 s")
+                   .arg(sTranscoding)
+                   .arg(transcodeTime.elapsed()/1000));
+#endif
+        if(jobs.value(sTranscoding).sTarget == sTranscodeTarget)
+            jobs[sTranscoding].bReady = true;
+    }
+    else {
+        QFile::remove(sPartial);
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to transcode %1: %2")
+                   .arg(sTranscoding,
+                        QString::fromLocal8Bit(transcodeProcess.readAllStandardError()).trimmed()));
+        if((exitStatus == QProcess::NormalExit) && (exitCode == COMMAND_NOT_FOUND))
+            bFfmpegAvailable = false;
+    }
+    sTranscoding.clear();
+    sTranscodeTarget.clear();
+    processNext();
+}
+
+
+// After the other errors finished() is emitted as well
+void
+SpotTranscoder::onTranscodeError(QProcess::ProcessError error) {
+    if(error != QProcess::FailedToStart)
+        return;
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("Unable to start %1: the spots will not be transcoded")
+               .arg(transcodeProcess.program()));
+    bBusy = false;
+    bFfmpegAvailable = false;
+    sTranscoding.clear();
+    sTranscodeTarget.clear();
+    processNext();
+}
+
+
+// The conversions of the spots no more in the directory are
+// removed, but only when every needed conversion is known.
+void
+SpotTranscoder::removeUnusedFiles() {
+    QSet<QString> neededFiles;
+    for(const Job& job : std::as_const(jobs)) {
+        if(job.sTarget.isEmpty())
+            return;
+        neededFiles.insert(QFileInfo(job.sTarget).fileName());
+    }
+    QDir dir(cacheDir());
+    if(!dir.exists())
+        return;
+    const QStringList cachedFiles = dir.entryList(QStringList() << "*.mp4" << "*.part", QDir::Files);
+    for(const QString& sFile : cachedFiles) {
+        if(!neededFiles.contains(sFile))
+            dir.remove(sFile);
+    }
+}
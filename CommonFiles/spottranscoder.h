@@ -0,0 +1,93 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QFile>
+#include <QFileInfoList>
+#include <QProcess>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSize>
+
+#include "spotindex.h"
+
+
+// Converts in background the spots the panel could not decode
+// in hardware (other codecs, profiles, levels or pixel formats,
+// or more pixels than the panel) to H.264 High@4.1 at most as
+// big as the panel. The results are cached by the hash of the
+// spot content: the spot loop plays them in place of the
+// originals once they are ready.
+class SpotTranscoder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SpotTranscoder(QFile* myLogFile = nullptr, QObject *parent = nullptr);
+    ~SpotTranscoder();
+
+public:
+    void setLimits(int nThreads, int iNiceness);
+    void update(const QString& sDir, const QList<SpotInfo>& spots, QSize panelSize);
+    QFileInfoList playableList(const QFileInfoList& spotList) const;
+
+private slots:
+    void onHashReady(QString sSpot, QString sKey, QString sHash);
+    void onTranscodeFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onTranscodeError(QProcess::ProcessError error);
+
+private:
+    static QString cacheDir();
+    static QString spotKey(const QString& sSpot, const SpotInfo& spot);
+    bool needsTranscode(const SpotInfo& spot) const;
+    QString targetFileName(const QString& sHash) const;
+    void processNext();
+    void hashSpot(const QString& sSpot, const QString& sKey);
+    void startTranscode(const QString& sSpot, const QString& sTarget);
+    void removeUnusedFiles();
+
+private:
+    // What is known of every spot needing the conversion
+    struct Job {
+        QString sKey;     // Path, size and modification time
+        QString sTarget;  // Empty until the content is hashed
+        bool    bReady = false;
+    };
+
+private:
+    QFile*              pLogFile;
+    QHash<QString, Job> jobs;
+    QHash<QString, QString> hashes;
+    QStringList         pendingSpots;
+    QString             sTranscoding;
+    QString             sTranscodeTarget;
+    QString             sFfmpeg;
+    QSize               panelSize;
+    QProcess            transcodeProcess;
+    QElapsedTimer       transcodeTime;
+    QThreadPool         hashPool;
+    QAtomicInt          iGeneration;
+    int                 nThreads;
+    int                 iNiceness;
+    bool                bBusy;
+    bool                bFfmpegAvailable;
+};
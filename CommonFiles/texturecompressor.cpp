@@ -0,0 +1,347 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "texturecompressor.h"
+
+#include <QOpenGLContext>
+#include <climits>
+
+
+namespace {
+// ETC1 intensity modifier tables: the pixel indices 0..3
+// select +small, +large, -small, -large
+const int etcModifiers[8][2] = {
+    { 2,   8}, { 5,  17}, { 9,  29}, {13,  42},
+    {18,  60}, {24,  80}, {33, 106}, {47, 183}
+};
+
+
+inline int
+clamp255(int value) {
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+
+inline int
+colorDistance(const int a[3], const uchar b[3]) {
+    int dr = a[0]-b[0];
+    int dg = a[1]-b[1];
+    int db = a[2]-b[2];
+    return dr*dr + dg*dg + db*db;
+}
+
+
+inline quint16
+toRgb565(const int color[3]) {
+    return quint16(((color[0]*31+127)/255) << 11 |
+                   ((color[1]*63+127)/255) << 5  |
+                   ((color[2]*31+127)/255));
+}
+
+
+inline void
+fromRgb565(quint16 color, int rgb[3]) {
+    int r = (color >> 11) & 0x1f;
+    int g = (color >> 5)  & 0x3f;
+    int b =  color        & 0x1f;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+
+// Best table (and the pixel indices) for an ETC1 sub block.
+// Returns the squared error.
+int
+fitEtcSubBlock(const uchar pixels[16][3], const bool inSubBlock[16],
+               const int base[3], int* pTable, int indices[16])
+{
+    int bestError = INT_MAX;
+    for(int iTable=0; iTable<8; iTable++) {
+        int error = 0;
+        int tableIndices[16] = {};
+        for(int i=0; i<16; i++) {
+            if(!inSubBlock[i])
+                continue;
+            int bestPixel = INT_MAX;
+            for(int iIndex=0; iIndex<4; iIndex++) {
+                int modifier = etcModifiers[iTable][iIndex & 1];
+                if(iIndex & 2) modifier = -modifier;
+                int color[3] = {clamp255(base[0]+modifier),
+                                clamp255(base[1]+modifier),
+                                clamp255(base[2]+modifier)};
+                int distance = colorDistance(color, pixels[i]);
+                if(distance < bestPixel) {
+                    bestPixel = distance;
+                    tableIndices[i] = iIndex;
+                }
+            }
+            error += bestPixel;
+        }
+        if(error < bestError) {
+            bestError = error;
+            *pTable = iTable;
+            for(int i=0; i<16; i++)
+                if(inSubBlock[i]) indices[i] = tableIndices[i];
+        }
+    }
+    return bestError;
+}
+}
+
+
+// Must be called with pContext current
+TextureCompressor::Format
+TextureCompressor::supportedFormat(QOpenGLContext* pContext) {
+    if(!pContext)
+        return NoCompression;
+    if(pContext->isOpenGLES()) {
+        if(pContext->format().majorVersion() >= 3) // ETC2 is core in OpenGL ES 3.0
+            return Etc2;
+        if(pContext->hasExtension("GL_OES_compressed_ETC1_RGB8_texture"))
+            return Etc1;
+        return NoCompression;
+    }
+    if(pContext->hasExtension("GL_EXT_texture_compression_s3tc") ||
+       pContext->hasExtension("GL_EXT_texture_compression_dxt1"))
+        return Bc1;
+    if((pContext->format().version() >= qMakePair(4, 3)) ||
+       pContext->hasExtension("GL_ARB_ES3_compatibility"))
+        return Etc2;
+    return NoCompression;
+}
+
+
+const char*
+TextureCompressor::formatName(Format format) {
+    switch(format) {
+    case Bc1:  return "BC1";
+    case Etc1: return "ETC1";
+    case Etc2: return "ETC2";
+    default:   return "RGBA";
+    }
+}
+
+
+int
+TextureCompressor::compressedSize(QSize size) {
+    return ((size.width()+3)/4) * ((size.height()+3)/4) * 8;
+}
+
+
+// The image must be opaque (the slides are): the alpha is ignored.
+// The last row and column are repeated to fill the partial blocks.
+// Slow enough to be called only from the worker threads.
+QByteArray
+TextureCompressor::compress(const QImage& image, Format format) {
+    if(image.isNull() || (format == NoCompression))
+        return QByteArray();
+    QImage rgbImage = image.convertToFormat(QImage::Format_RGBX8888);
+    int width  = rgbImage.width();
+    int height = rgbImage.height();
+    QByteArray blocks(compressedSize(rgbImage.size()), Qt::Uninitialized);
+    uchar* pBlock = reinterpret_cast<uchar*>(blocks.data());
+    uchar pixels[16][3];
+    for(int by=0; by<height; by+=4) {
+        for(int bx=0; bx<width; bx+=4) {
+            for(int y=0; y<4; y++) {
+                const uchar* pLine = rgbImage.constScanLine(qMin(by+y, height-1));
+                for(int x=0; x<4; x++) {
+                    const uchar* pPixel = pLine + 4*qMin(bx+x, width-1);
+                    pixels[y*4+x][0] = pPixel[0];
+                    pixels[y*4+x][1] = pPixel[1];
+                    pixels[y*4+x][2] = pPixel[2];
+                }
+            }
+            if(format == Bc1)
+                encodeBc1Block(pixels, pBlock);
+            else // ETC1 blocks are valid ETC2 blocks
+                encodeEtc1Block(pixels, pBlock);
+            pBlock += 8;
+        }
+    }
+    return blocks;
+}
+
+
+// Endpoints at the extremes of the colors projected on their
+// principal axis (slightly inset), always in the 4 color mode.
+// Pixels are in row order.
+void
+TextureCompressor::encodeBc1Block(const uchar pixels[16][3], uchar* pBlock) {
+    float mean[3] = {};
+    for(int i=0; i<16; i++)
+        for(int c=0; c<3; c++)
+            mean[c] += pixels[i][c] / 16.0f;
+    float covariance[3][3] = {};
+    for(int i=0; i<16; i++)
+        for(int r=0; r<3; r++)
+            for(int c=0; c<3; c++)
+                covariance[r][c] += (pixels[i][r]-mean[r]) * (pixels[i][c]-mean[c]);
+    // A few power iterations are enough for the dominant axis
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for(int iIter=0; iIter<6; iIter++) {
+        float next[3] = {};
+        for(int r=0; r<3; r++)
+            for(int c=0; c<3; c++)
+                next[r] += covariance[r][c] * axis[c];
+        float norm = qMax(qMax(qAbs(next[0]), qAbs(next[1])), qAbs(next[2]));
+        if(norm < 1.0e-6f)
+            break;
+        for(int c=0; c<3; c++)
+            axis[c] = next[c] / norm;
+    }
+    float axisLength2 = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+    float tMin = 0.0f;
+    float tMax = 0.0f;
+    for(int i=0; i<16; i++) {
+        float t = ((pixels[i][0]-mean[0])*axis[0] +
+                   (pixels[i][1]-mean[1])*axis[1] +
+                   (pixels[i][2]-mean[2])*axis[2]) / axisLength2;
+        tMin = qMin(tMin, t);
+        tMax = qMax(tMax, t);
+    }
+    float inset = (tMax - tMin) / 16.0f;
+    tMin += inset;
+    tMax -= inset;
+    int minColor[3];
+    int maxColor[3];
+    for(int c=0; c<3; c++) {
+        minColor[c] = clamp255(qRound(mean[c] + tMin*axis[c]));
+        maxColor[c] = clamp255(qRound(mean[c] + tMax*axis[c]));
+    }
+    quint16 color0 = toRgb565(maxColor);
+    quint16 color1 = toRgb565(minColor);
+    quint32 indices = 0;
+    if(color0 < color1)
+        qSwap(color0, color1);
+    if(color0 != color1) {
+        int palette[4][3];
+        fromRgb565(color0, palette[0]);
+        fromRgb565(color1, palette[1]);
+        for(int c=0; c<3; c++) {
+            palette[2][c] = (2*palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2*palette[1][c]) / 3;
+        }
+        for(int i=0; i<16; i++) {
+            int iBest = 0;
+            int bestDistance = INT_MAX;
+            for(int iColor=0; iColor<4; iColor++) {
+                int distance = colorDistance(palette[iColor], pixels[i]);
+                if(distance < bestDistance) {
+                    bestDistance = distance;
+                    iBest = iColor;
+                }
+            }
+            indices |= quint32(iBest) << (2*i);
+        }
+    }
+    // Little endian
+    pBlock[0] = uchar(color0);
+    pBlock[1] = uchar(color0 >> 8);
+    pBlock[2] = uchar(color1);
+    pBlock[3] = uchar(color1 >> 8);
+    pBlock[4] = uchar(indices);
+    pBlock[5] = uchar(indices >> 8);
+    pBlock[6] = uchar(indices >> 16);
+    pBlock[7] = uchar(indices >> 24);
+}
+
+
+// Both the sub block orientations are tried: each sub block gets
+// its average color (differential mode when the two are close
+// enough, individual mode otherwise) and the best modifier table.
+void
+TextureCompressor::encodeEtc1Block(const uchar pixels[16][3], uchar* pBlock) {
+    quint32 bestHigh = 0;
+    quint32 bestLow  = 0;
+    int bestError = INT_MAX;
+    for(int iFlip=0; iFlip<2; iFlip++) {
+        bool inSubBlock[2][16];
+        int sum[2][3] = {};
+        for(int i=0; i<16; i++) {
+            int x = i % 4;
+            int y = i / 4;
+            int iSub = iFlip ? (y >= 2) : (x >= 2);
+            inSubBlock[0][i] = (iSub == 0);
+            inSubBlock[1][i] = (iSub == 1);
+            for(int c=0; c<3; c++)
+                sum[iSub][c] += pixels[i][c];
+        }
+        int quantized[2][3];
+        int base[2][3];
+        bool bDifferential = true;
+        for(int s=0; s<2; s++)
+            for(int c=0; c<3; c++)
+                quantized[s][c] = (sum[s][c]*31 + 4*255) / (8*255);
+        for(int c=0; c<3; c++) {
+            int delta = quantized[1][c] - quantized[0][c];
+            if((delta < -4) || (delta > 3))
+                bDifferential = false;
+        }
+        if(bDifferential) {
+            for(int s=0; s<2; s++)
+                for(int c=0; c<3; c++)
+                    base[s][c] = (quantized[s][c] << 3) | (quantized[s][c] >> 2);
+        }
+        else {
+            for(int s=0; s<2; s++) {
+                for(int c=0; c<3; c++) {
+                    quantized[s][c] = (sum[s][c]*15 + 4*255) / (8*255);
+                    base[s][c] = (quantized[s][c] << 4) | quantized[s][c];
+                }
+            }
+        }
+        int table[2] = {};
+        int indices[16] = {};
+        int error = fitEtcSubBlock(pixels, inSubBlock[0], base[0], &table[0], indices) +
+                    fitEtcSubBlock(pixels, inSubBlock[1], base[1], &table[1], indices);
+        if(error >= bestError)
+            continue;
+        bestError = error;
+        if(bDifferential) {
+            bestHigh = quint32(quantized[0][0]) << 27 | quint32((quantized[1][0]-quantized[0][0]) & 7) << 24 |
+                       quint32(quantized[0][1]) << 19 | quint32((quantized[1][1]-quantized[0][1]) & 7) << 16 |
+                       quint32(quantized[0][2]) << 11 | quint32((quantized[1][2]-quantized[0][2]) & 7) << 8  |
+                       1u << 1;
+        }
+        else {
+            bestHigh = quint32(quantized[0][0]) << 28 | quint32(quantized[1][0]) << 24 |
+                       quint32(quantized[0][1]) << 20 | quint32(quantized[1][1]) << 16 |
+                       quint32(quantized[0][2]) << 12 | quint32(quantized[1][2]) << 8;
+        }
+        bestHigh |= quint32(table[0]) << 5 | quint32(table[1]) << 2 | quint32(iFlip);
+        // Pixel indices are stored column by column:
+        // most significant bits first, then the least ones
+        bestLow = 0;
+        for(int i=0; i<16; i++) {
+            int iBit = (i % 4)*4 + (i / 4);
+            bestLow |= quint32(indices[i] >> 1) << (16 + iBit);
+            bestLow |= quint32(indices[i] & 1) << iBit;
+        }
+    }
+    // Big endian
+    pBlock[0] = uchar(bestHigh >> 24);
+    pBlock[1] = uchar(bestHigh >> 16);
+    pBlock[2] = uchar(bestHigh >> 8);
+    pBlock[3] = uchar(bestHigh);
+    pBlock[4] = uchar(bestLow >> 24);
+    pBlock[5] = uchar(bestLow >> 16);
+    pBlock[6] = uchar(bestLow >> 8);
+    pBlock[7] = uchar(bestLow);
+}
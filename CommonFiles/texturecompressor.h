@@ -0,0 +1,63 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QImage>
+#include <QByteArray>
+#include <QSize>
+
+
+QT_FORWARD_DECLARE_CLASS(QOpenGLContext)
+
+
+// Block compression of the slides for the texture formats every
+// panel GPU can sample directly: BC1 (DXT1) on the desktop, ETC2
+// (or its ETC1 subset on OpenGL ES 2.0) on the Raspberry Pi.
+// All the formats take 8 bytes for each 4x4 block of texels.
+// CPU only: it is used by the worker threads and does not need QtOpenGL.
+class TextureCompressor
+{
+public:
+    enum Format {
+        NoCompression,
+        Bc1,
+        Etc1,
+        Etc2
+    };
+
+public:
+    static Format supportedFormat(QOpenGLContext* pContext);
+    static const char* formatName(Format format);
+    static int compressedSize(QSize size);
+    static QByteArray compress(const QImage& image, Format format);
+
+private:
+    static void encodeBc1Block(const uchar pixels[16][3], uchar* pBlock);
+    static void encodeEtc1Block(const uchar pixels[16][3], uchar* pBlock);
+};
+
+
+// A slide ready for glCompressedTexImage2D()
+struct CompressedImage {
+    QSize                     size;
+    TextureCompressor::Format format = TextureCompressor::NoCompression;
+    QByteArray                blocks;
+
+    bool isNull() const { return blocks.isEmpty(); }
+};
@@ -0,0 +1,247 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "transitiongovernor.h"
+#include "utility.h"
+
+#include <QDir>
+
+#include <cstdlib>
+
+
+#define AVERAGE_WEIGHT     0.5  // Weight of the last run in the running averages
+#define MAX_DROP_RATIO     0.25 // Above this the transition is chosen only to be measured again
+#define DROP_PENALTY      20.0  // How fast the weight decreases with the dropped frames
+#define MIN_WEIGHT         0.05 // Still chosen, rarely, to be measured again
+#define FRAME_MARGIN       1.1  // Tolerance over the refresh interval
+#define THERMAL_LIMIT  80000    // m°C: the RPi firmware throttles from 80 °C
+
+
+TransitionGovernor::TransitionGovernor(QFile* myLogFile)
+    : pLogFile(myLogFile)
+    , msRefresh(1000.0/60.0)
+    , bThrottled(false)
+{
+}
+
+
+void
+TransitionGovernor::setTransitions(const QStringList& names) {
+    transitionNames = names;
+    performance.fill(Performance(), names.count());
+}
+
+
+void
+TransitionGovernor::setRefreshRate(double refreshRate) {
+    if(refreshRate <= 0.0) refreshRate = 60.0;
+    msRefresh = 1000.0 / refreshRate;
+}
+
+
+// Weighted random choice. Transitions never measured have the full
+// weight so that every one gets its chance. Returns -1 only when no
+// transition is usable.
+int
+TransitionGovernor::chooseTransition() {
+    if(performance.isEmpty())
+        return 0;
+    double totalWeight = 0.0;
+    for(const Performance& p : std::as_const(performance))
+        totalWeight += p.weight;
+    if(totalWeight <= 0.0)
+        return cheapestTransition();
+    double choice = totalWeight * double(rand()) / (double(RAND_MAX) + 1.0);
+    for(int i=0; i<performance.count(); i++) {
+        choice -= performance.at(i).weight;
+        if(choice < 0.0)
+            return i;
+    }
+    return cheapestTransition(); // Rounding
+}
+
+
+// A transition that cannot be built on this panel is never chosen again
+void
+TransitionGovernor::disableTransition(int iTransition) {
+    if((iTransition < 0) || (iTransition >= performance.count()))
+        return;
+    performance[iTransition].bUsable = false;
+    performance[iTransition].weight  = 0.0;
+}
+
+
+bool
+TransitionGovernor::isUsable(int iTransition) const {
+    if((iTransition < 0) || (iTransition >= performance.count()))
+        return false;
+    return performance.at(iTransition).bUsable;
+}
+
+
+// Called at the end of every transition with its frame counts
+void
+TransitionGovernor::transitionDone(int iTransition, int nFrames, int nDropped, double msElapsed) {
+    if((iTransition < 0) || (iTransition >= performance.count()) || (nFrames <= 0))
+        return;
+    Performance& p = performance[iTransition];
+    if(!p.bWarmedUp) {
+        // Shader build, first uploads and driver warm up
+        // would penalize the transition for good
+        p.bWarmedUp = true;
+#ifdef LOG_VERBOSE
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("%1: first run not measured (%2 dropped)")
+                   .arg(transitionNames.value(iTransition))
+                   .arg(nDropped));
+#endif
+        return;
+    }
+    double dropRatio = double(nDropped) / double(nFrames + nDropped);
+    double msFrame   = msElapsed / double(nFrames);
+    if(p.nRuns == 0) {
+        p.dropRatio = dropRatio;
+        p.msFrame   = msFrame;
+    }
+    else {
+        p.dropRatio += AVERAGE_WEIGHT * (dropRatio - p.dropRatio);
+        p.msFrame   += AVERAGE_WEIGHT * (msFrame - p.msFrame);
+    }
+    p.nRuns++;
+    bool bWasThrottled = bThrottled;
+    bThrottled = readThrottling() > 0.0;
+    if(bThrottled != bWasThrottled)
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   bThrottled ? QString("SoC throttling: keeping only the cheap transitions")
+                              : QString("SoC throttling ended"));
+    updateWeights();
+#ifdef LOG_MESG
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("%1: %2 ms/frame, %3% dropped, weight %4")
+               .arg(transitionNames.value(iTransition))
+               .arg(p.msFrame, 0, 'f', 1)
+               .arg(100.0*p.dropRatio, 0, 'f', 0)
+               .arg(p.weight, 0, 'f', 2));
+#endif
+}
+
+
+void
+TransitionGovernor::updateWeights() {
+    for(int i=0; i<performance.count(); i++) {
+        Performance& p = performance[i];
+        if(!p.bUsable) {
+            p.weight = 0.0;
+            continue;
+        }
+        if(p.nRuns == 0) {
+            p.weight = bThrottled ? 0.0 : 1.0; // No experiments when hot
+            continue;
+        }
+        if(p.dropRatio > MAX_DROP_RATIO)
+            p.weight = MIN_WEIGHT; // The running average can recover
+        else
+            p.weight = qMax(1.0/(1.0 + DROP_PENALTY*p.dropRatio), MIN_WEIGHT);
+        if(bThrottled && (p.msFrame > FRAME_MARGIN*msRefresh))
+            p.weight = 0.0;
+    }
+}
+
+
+// The replacement when no transition fits the budget
+int
+TransitionGovernor::cheapestTransition() const {
+    int iBest = -1;
+    for(int i=0; i<performance.count(); i++) {
+        const Performance& p = performance.at(i);
+        if(!p.bUsable)
+            continue;
+        if(iBest < 0) {
+            iBest = i;
+            continue;
+        }
+        const Performance& best = performance.at(iBest);
+        if(p.nRuns == 0)
+            continue;
+        if((best.nRuns == 0) || (p.msFrame < best.msFrame))
+            iBest = i;
+    }
+    return iBest;
+}
+
+
+bool
+TransitionGovernor::isThrottled() const {
+    return bThrottled;
+}
+
+
+// Greater than zero when a frequency limiting cooling device is active
+// (fans do not count) or a thermal zone is over the throttling limit.
+// Nothing happens where /sys/class/thermal does not exist.
+double
+TransitionGovernor::readThrottling() {
+    QDir thermalDir("/sys/class/thermal");
+    if(!thermalDir.exists())
+        return 0.0;
+    double throttling = 0.0;
+    const QStringList devices = thermalDir.entryList(QStringList() << "cooling_device*", QDir::Dirs | QDir::System);
+    for(const QString& sDevice : devices) {
+        QFile typeFile(thermalDir.filePath(sDevice + "/type"));
+        if(!typeFile.open(QIODevice::ReadOnly))
+            continue;
+        QString sType = QString::fromLatin1(typeFile.readAll());
+        if(!sType.contains("freq") && !sType.contains("Processor"))
+            continue;
+        QFile stateFile(thermalDir.filePath(sDevice + "/cur_state"));
+        if(stateFile.open(QIODevice::ReadOnly))
+            throttling = qMax(throttling, stateFile.readAll().trimmed().toDouble());
+    }
+    const QStringList zones = thermalDir.entryList(QStringList() << "thermal_zone*", QDir::Dirs | QDir::System);
+    for(const QString& sZone : zones) {
+        QFile tempFile(thermalDir.filePath(sZone + "/temp"));
+        if(tempFile.open(QIODevice::ReadOnly) &&
+           (tempFile.readAll().trimmed().toInt() >= THERMAL_LIMIT))
+            throttling = qMax(throttling, 1.0);
+    }
+    return throttling;
+}
+
+
+void
+TransitionGovernor::logState() const {
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("Refresh %1 ms, %2")
+               .arg(msRefresh, 0, 'f', 1)
+               .arg(bThrottled ? "throttled" : "not throttled"));
+    for(int i=0; i<performance.count(); i++) {
+        const Performance& p = performance.at(i);
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("%1 runs:%2 %3 ms/frame %4% dropped weight:%5")
+                   .arg(transitionNames.at(i), -18)
+                   .arg(p.nRuns)
+                   .arg(p.msFrame, 0, 'f', 1)
+                   .arg(100.0*p.dropRatio, 0, 'f', 0)
+                   .arg(p.weight, 0, 'f', 2));
+    }
+}
@@ -0,0 +1,64 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QVector>
+#include <QStringList>
+#include <QFile>
+
+
+// Chooses the next transition from how the transitions actually
+// performed on this panel: the ones missing frames are chosen less
+// often, or not at all, and while the SoC is throttling only those
+// fitting the refresh budget are kept.
+class TransitionGovernor
+{
+public:
+    explicit TransitionGovernor(QFile* myLogFile = nullptr);
+
+public:
+    void setTransitions(const QStringList& names);
+    void setRefreshRate(double refreshRate);
+    int  chooseTransition();
+    void disableTransition(int iTransition);
+    bool isUsable(int iTransition) const;
+    void transitionDone(int iTransition, int nFrames, int nDropped, double msElapsed);
+    bool isThrottled() const;
+    void logState() const;
+
+private:
+    struct Performance {
+        bool   bUsable      = true;  // False if its shaders did not build
+        bool   bWarmedUp    = false; // The first run is not measured
+        int    nRuns        = 0;
+        double dropRatio    = 0.0; // Running averages
+        double msFrame      = 0.0;
+        double weight       = 1.0;
+    };
+    void   updateWeights();
+    double readThrottling();
+    int    cheapestTransition() const;
+
+private:
+    QFile*               pLogFile;
+    QStringList          transitionNames;
+    QVector<Performance> performance;
+    double               msRefresh;
+    bool                 bThrottled;
+};
@@ -0,0 +1,121 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "transitionlist.h"
+
+#include <QFile>
+
+
+// The transitions available to the Slide Show.
+// All the current ones do their work in the fragment shader
+// (vShader.glsl is a pass-through) so they need no grid.
+// The ones missing from a shader directory are skipped.
+QList<TransitionEntry>
+transitionList() {
+    return QList<TransitionEntry>({
+        {"fFilmBurn", fullScreenMesh},
+        {"fDoomScreen", fullScreenMesh},
+        {"fPolkaDotsCurtain", fullScreenMesh},
+        {"fSwap", fullScreenMesh},
+        {"fBookFlip", fullScreenMesh},
+        {"fAngular", fullScreenMesh},
+        {"fBounce", fullScreenMesh},
+        {"fWaterDrop", fullScreenMesh},
+        {"fFlyEye", fullScreenMesh},
+        {"fMorph", fullScreenMesh},
+        {"fPerlin", fullScreenMesh},
+        {"fPinwheel", fullScreenMesh},
+        {"fPowerKaleido", fullScreenMesh},
+        {"fInvertedPageCurl", fullScreenMesh},
+        {"fDisplacement", fullScreenMesh},
+        {"fSwirl", fullScreenMesh},
+        {"fDreamy", fullScreenMesh},
+        {"fCrosshatch", fullScreenMesh},
+        {"fRadial", fullScreenMesh},
+        {"fRipple", fullScreenMesh},
+        {"fCircleopen", fullScreenMesh},
+        {"fFade", fullScreenMesh},
+        {"fMultiply_blend", fullScreenMesh},
+        {"fPixelize", fullScreenMesh},
+        {"fWind", fullScreenMesh},
+        {"fCrosswarp", fullScreenMesh}
+    });
+}
+
+
+// The fragment shader of a transition. The letterbox sampling
+// (fract, divide and border test for every texel) is compiled in
+// only with the GPU letterbox: the define has to follow #version.
+QByteArray
+transitionSource(const QString& sFileName, bool bGpuLetterbox) {
+    QFile shaderFile(sFileName);
+    if(!shaderFile.open(QIODevice::ReadOnly))
+        return QByteArray();
+    QByteArray source = shaderFile.readAll();
+    if(!bGpuLetterbox)
+        return source;
+    int iInsert = 0;
+    int iVersion = source.indexOf("#version");
+    if(iVersion >= 0)
+        iInsert = source.indexOf('\n', iVersion) + 1;
+    source.insert(iInsert, "#define GPU_LETTERBOX\n");
+    return source;
+}
+
+
+// All the meshes share the same vertex and index buffers:
+// a single triangle covering the whole screen (its texture
+// coordinates exceed 1 where it is clipped) and an indexed grid.
+void
+transitionMeshes(QVector<TransitionVertex>* pVertices,
+                 QVector<quint16>* pIndices,
+                 MeshRange meshRanges[nTransitionMeshes]) {
+    pVertices->clear();
+    pIndices->clear();
+    meshRanges[fullScreenMesh].iFirstIndex = pIndices->count();
+    pVertices->append({QVector3D(-1.0f, -1.0f, 0.0f), QVector2D(0.0f, 0.0f)});
+    pVertices->append({QVector3D( 3.0f, -1.0f, 0.0f), QVector2D(2.0f, 0.0f)});
+    pVertices->append({QVector3D(-1.0f,  3.0f, 0.0f), QVector2D(0.0f, 2.0f)});
+    *pIndices << 0 << 1 << 2;
+    meshRanges[fullScreenMesh].nIndices = pIndices->count() - meshRanges[fullScreenMesh].iFirstIndex;
+
+    int nxStep = 54;
+    int nyStep = 36;
+    quint16 iFirstVertex = quint16(pVertices->count());
+    for(int i=0; i<=nxStep; i++) {
+        float xT = float(i) / nxStep;
+        for(int j=0; j<=nyStep; j++) {
+            float yT = float(j) / nyStep;
+            pVertices->append({QVector3D(2.0f*xT-1.0f, 2.0f*yT-1.0f, 0.0f),
+                               QVector2D(xT, yT)});
+        }
+    }
+    meshRanges[gridMesh].iFirstIndex = pIndices->count();
+    for(int i=0; i<nxStep; i++) {
+        for(int j=0; j<nyStep; j++) {
+            quint16 i00 = quint16(iFirstVertex + i*(nyStep+1) + j);
+            quint16 i01 = quint16(i00 + 1);
+            quint16 i10 = quint16(i00 + nyStep + 1);
+            quint16 i11 = quint16(i10 + 1);
+            // Two counter clockwise triangles per cell
+            *pIndices << i00 << i10 << i01;
+            *pIndices << i10 << i11 << i01;
+        }
+    }
+    meshRanges[gridMesh].nIndices = pIndices->count() - meshRanges[gridMesh].iFirstIndex;
+}
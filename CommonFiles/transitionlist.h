@@ -0,0 +1,61 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+#include <QVector2D>
+#include <QVector3D>
+
+
+// How finely the screen has to be tessellated for a transition:
+// transitions working only in the fragment shader need just one
+// triangle covering the screen, vertex displacing ones a dense grid.
+enum transitionMesh {
+    fullScreenMesh,
+    gridMesh,
+    nTransitionMeshes
+};
+
+
+struct TransitionEntry {
+    QString        sShader;
+    transitionMesh mesh;
+};
+
+
+struct TransitionVertex {
+    QVector3D position;
+    QVector2D texCoord;
+};
+
+
+struct MeshRange {
+    int iFirstIndex = 0;
+    int nIndices    = 0;
+};
+
+
+QList<TransitionEntry> transitionList();
+QByteArray transitionSource(const QString& sFileName, bool bGpuLetterbox);
+void transitionMeshes(QVector<TransitionVertex>* pVertices,
+                      QVector<quint16>* pIndices,
+                      MeshRange meshRanges[nTransitionMeshes]);
@@ -0,0 +1,107 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "transitionstats.h"
+
+#include <algorithm>
+
+
+void
+TransitionStats::addRun(const QString& sTransition) {
+    statsHash[sTransition].nRuns++;
+}
+
+
+void
+TransitionStats::addCpuTime(const QString& sTransition, double msCpu) {
+    FrameStats& frameStats = statsHash[sTransition];
+    frameStats.nFrames++;
+    frameStats.msCpuTotal += msCpu;
+    frameStats.msCpuMax = std::max(frameStats.msCpuMax, msCpu);
+}
+
+
+void
+TransitionStats::addGpuTime(const QString& sTransition, double msGpu) {
+    FrameStats& frameStats = statsHash[sTransition];
+    frameStats.nGpuFrames++;
+    frameStats.msGpuTotal += msGpu;
+    frameStats.msGpuMax = std::max(frameStats.msGpuMax, msGpu);
+}
+
+
+void
+TransitionStats::addSwap(const QString& sTransition, double msSwap, int nDropped) {
+    FrameStats& frameStats = statsHash[sTransition];
+    frameStats.nSwaps++;
+    frameStats.nDropped += nDropped;
+    frameStats.msSwapTotal += msSwap;
+    frameStats.msSwapMax = std::max(frameStats.msSwapMax, msSwap);
+}
+
+
+FrameStats
+TransitionStats::stats(const QString& sTransition) const {
+    return statsHash.value(sTransition);
+}
+
+
+QStringList
+TransitionStats::transitions() const {
+    QStringList names = statsHash.keys();
+    names.sort();
+    return names;
+}
+
+
+void
+TransitionStats::clear() {
+    statsHash.clear();
+}
+
+
+// One line per transition: mean/max times in ms
+QString
+TransitionStats::summary(const QString& sTransition) const {
+    FrameStats s = statsHash.value(sTransition);
+    QString sGpu("n.a.");
+    if(s.nGpuFrames > 0)
+        sGpu = QString("%1/%2")
+                   .arg(s.msGpuTotal/s.nGpuFrames, 0, 'f', 2)
+                   .arg(s.msGpuMax, 0, 'f', 2);
+    return QString("%1 runs:%2 frames:%3 dropped:%4 cpu:%5/%6 gpu:%7 swap:%8/%9")
+        .arg(sTransition, -18)
+        .arg(s.nRuns)
+        .arg(s.nFrames)
+        .arg(s.nDropped)
+        .arg(s.nFrames > 0 ? s.msCpuTotal/s.nFrames : 0.0, 0, 'f', 2)
+        .arg(s.msCpuMax, 0, 'f', 2)
+        .arg(sGpu)
+        .arg(s.nSwaps > 0 ? s.msSwapTotal/s.nSwaps : 0.0, 0, 'f', 2)
+        .arg(s.msSwapMax, 0, 'f', 2);
+}
+
+
+QStringList
+TransitionStats::report() const {
+    QStringList lines;
+    const QStringList names = transitions();
+    for(const QString& sName : names)
+        lines.append(summary(sName));
+    return lines;
+}
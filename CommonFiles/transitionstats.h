@@ -0,0 +1,58 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+
+
+// Frame timings of the Slide Show transitions,
+// aggregated by transition (shader) name.
+struct FrameStats {
+    int    nRuns       = 0;
+    int    nFrames     = 0;
+    int    nDropped    = 0;
+    double msCpuTotal  = 0.0;
+    double msCpuMax    = 0.0;
+    int    nGpuFrames  = 0; // Not every GL implementation has timer queries
+    double msGpuTotal  = 0.0;
+    double msGpuMax    = 0.0;
+    int    nSwaps      = 0;
+    double msSwapTotal = 0.0;
+    double msSwapMax   = 0.0;
+};
+
+
+class TransitionStats
+{
+public:
+    void addRun(const QString& sTransition);
+    void addCpuTime(const QString& sTransition, double msCpu);
+    void addGpuTime(const QString& sTransition, double msGpu);
+    void addSwap(const QString& sTransition, double msSwap, int nDropped);
+    FrameStats stats(const QString& sTransition) const;
+    QStringList transitions() const;
+    QStringList report() const;
+    QString summary(const QString& sTransition) const;
+    void clear();
+
+private:
+    QHash<QString, FrameStats> statsHash;
+};
@@ -18,6 +18,7 @@ QT += gui
 QT += widgets
 QT += opengl
 QT += openglwidgets
+QT += multimedia
 QT += bluetooth
 
 CONFIG += c++17
@@ -30,8 +31,21 @@ SOURCES += \
     ../CommonFiles/button.cpp \
     ../CommonFiles/edit.cpp \
     ../CommonFiles/scorecontroller.cpp \
+    ../CommonFiles/scoreticker.cpp \
     ../CommonFiles/scorepanel.cpp \
+    ../CommonFiles/slideprefetcher.cpp \
+    ../CommonFiles/slidecache.cpp \
+    ../CommonFiles/sliderenderer.cpp \
+    ../CommonFiles/slidetransitions.cpp \
     ../CommonFiles/slidewidget.cpp \
+    ../CommonFiles/slidewindow.cpp \
+    ../CommonFiles/spotindex.cpp \
+    ../CommonFiles/spotplayer.cpp \
+    ../CommonFiles/spottranscoder.cpp \
+    ../CommonFiles/texturecompressor.cpp \
+    ../CommonFiles/transitiongovernor.cpp \
+    ../CommonFiles/transitionlist.cpp \
+    ../CommonFiles/transitionstats.cpp \
     ../CommonFiles/utility.cpp \
     generalsetuparguments.cpp \
     generalsetupdialog.cpp \
@@ -47,8 +61,21 @@ HEADERS += \
     ../CommonFiles/edit.h \
     ../CommonFiles/panelorientation.h \
     ../CommonFiles/scorecontroller.h \
+    ../CommonFiles/scoreticker.h \
     ../CommonFiles/scorepanel.h \
+    ../CommonFiles/slideprefetcher.h \
+    ../CommonFiles/slidecache.h \
+    ../CommonFiles/sliderenderer.h \
+    ../CommonFiles/slidetransitions.h \
     ../CommonFiles/slidewidget.h \
+    ../CommonFiles/slidewindow.h \
+    ../CommonFiles/spotindex.h \
+    ../CommonFiles/spotplayer.h \
+    ../CommonFiles/spottranscoder.h \
+    ../CommonFiles/texturecompressor.h \
+    ../CommonFiles/transitiongovernor.h \
+    ../CommonFiles/transitionlist.h \
+    ../CommonFiles/transitionstats.h \
     ../CommonFiles/utility.h \
     generalsetuparguments.h \
     generalsetupdialog.h \
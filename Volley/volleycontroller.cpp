@@ -65,6 +65,7 @@ VolleyController::VolleyController(QFile *myLogFile, QWidget *parent)
     setPalette(panelPalette);
 
     GetSettings();
+    pSpotIndex->setDirectory(gsArgs.sSpotDir);
 
     buildControls();
     setWindowLayout();
@@ -104,6 +105,13 @@ VolleyController::resizeEvent(QResizeEvent *event) {
 }
 
 
+// The panel to be captured as the first slide of the Slide Show
+QWidget*
+VolleyController::scorePanel() {
+    return pVolleyPanel;
+}
+
+
 void
 VolleyController::GeneralSetup() {
     GeneralSetupDialog* pGeneralSetupDialog = new GeneralSetupDialog(&gsArgs);
@@ -322,6 +330,8 @@ VolleyController::sendAll() {
         pVolleyPanel->setTimeout(i, iTimeout[i]);
         pVolleyPanel->setSets(i, iSet[i]);
         pVolleyPanel->setScore(i, iScore[i]);
+        setTickerTeam(i, pTeamName[i]->text());
+        setTickerScore(i, iScore[i]);
     }
     pVolleyPanel->setServizio(iServizio);
     pVolleyPanel->setLogo(0, gsArgs.sTeamLogoFilePath[0]);
@@ -679,6 +689,7 @@ VolleyController::onScoreIncrement(int iTeam) {
         pScoreIncrement[iTeam]->setEnabled(false);
     }
     pVolleyPanel->setScore(iTeam, iScore[iTeam]);
+    setTickerScore(iTeam, iScore[iTeam]);
     lastService = iServizio;
     iServizio = iTeam;
     pService[iServizio ? 1 : 0]->setChecked(true);
@@ -717,6 +728,7 @@ VolleyController::onScoreDecrement(int iTeam) {
         pScoreDecrement[iTeam]->setEnabled(false);
     }
     pVolleyPanel->setScore(iTeam, iScore[iTeam]);
+    setTickerScore(iTeam, iScore[iTeam]);
     iServizio = lastService;
     pService[iServizio ? 1 : 0]->setChecked(true);
     pService[iServizio ? 0 : 1]->setChecked(false);
@@ -741,6 +753,7 @@ void
 VolleyController::onTeamTextChanged(QString sText, int iTeam) {
     gsArgs.sTeam[iTeam] = sText;
     pVolleyPanel->setTeam(iTeam, gsArgs.sTeam[iTeam]);
+    setTickerTeam(iTeam, gsArgs.sTeam[iTeam]);
     QString sMessage = QString("<team%1>%2</team%3>")
                    .arg(iTeam,1)
                    .arg(gsArgs.sTeam[iTeam])
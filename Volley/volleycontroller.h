@@ -52,6 +52,7 @@ protected:
     void          buildFontSizes();
     void          SaveStatus();
     void          GeneralSetup();
+    QWidget*      scorePanel();
 
 private slots:
     void closeEvent(QCloseEvent*);
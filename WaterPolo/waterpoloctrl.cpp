@@ -79,6 +79,7 @@ WaterPoloCtrl::WaterPoloCtrl(QFile *myLogFile, QWidget *parent)
     setPalette(panelPalette);
 
     GetSettings();
+    pSpotIndex->setDirectory(gsArgs.sSpotDir);
 
     buildControls();
     setWindowLayout();
@@ -231,6 +232,13 @@ WaterPoloCtrl::changeFocus() {
 }
 
 
+// The panel to be captured as the first slide of the Slide Show
+QWidget*
+WaterPoloCtrl::scorePanel() {
+    return pWaterPoloPanel;
+}
+
+
 void
 WaterPoloCtrl::GeneralSetup() {
     GeneralSetupDialog* pGeneralSetupDialog = new GeneralSetupDialog(&gsArgs);
@@ -506,6 +514,8 @@ WaterPoloCtrl::sendAll() {
     for(int i=0; i<2; i++) {
         pWaterPoloPanel->setTeam(i, pTeamName[i]->text());
         pWaterPoloPanel->setScore(i, iScore[i]);
+        setTickerTeam(i, pTeamName[i]->text());
+        setTickerScore(i, iScore[i]);
     }
     pWaterPoloPanel->setLogo(0, gsArgs.sTeamLogoFilePath[0]);
     pWaterPoloPanel->setLogo(1, gsArgs.sTeamLogoFilePath[1]);
@@ -911,6 +921,7 @@ WaterPoloCtrl::onScoreIncrement(int iTeam) {
         pScoreIncrement[iTeam]->setEnabled(false);
     }
     pWaterPoloPanel->setScore(iTeam, iScore[iTeam]);
+    setTickerScore(iTeam, iScore[iTeam]);
     QString sMessage = QString("<score%1>%2</score%3>")
                            .arg(iTeam,1)
                            .arg(iScore[iTeam], 2)
@@ -933,6 +944,7 @@ WaterPoloCtrl::onScoreDecrement(int iTeam) {
         pScoreDecrement[iTeam]->setEnabled(false);
     }
     pWaterPoloPanel->setScore(iTeam, iScore[iTeam]);
+    setTickerScore(iTeam, iScore[iTeam]);
     QString sMessage = QString("<score%1>%2</score%3>")
                            .arg(iTeam,1)
                            .arg(iScore[iTeam], 2)
@@ -951,6 +963,7 @@ void
 WaterPoloCtrl::onTeamTextChanged(QString sText, int iTeam) {
     gsArgs.sTeam[iTeam] = sText;
     pWaterPoloPanel->setTeam(iTeam, gsArgs.sTeam[iTeam]);
+    setTickerTeam(iTeam, gsArgs.sTeam[iTeam]);
     QString sMessage = QString("<team%1>%2</team%3>")
                            .arg(iTeam,1)
                            .arg(gsArgs.sTeam[iTeam])
@@ -62,6 +62,7 @@ protected:
     void          buildFontSizes();
     void          SaveStatus();
     void          GeneralSetup();
+    QWidget*      scorePanel();
 #ifndef Q_OS_ANDROID
     bool          connectToAlarm();
 #endif